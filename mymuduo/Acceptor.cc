@@ -1,11 +1,13 @@
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "EventLoop.h"
 
 #include <sys/types.h>    
 #include <sys/socket.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 // 创建非阻塞的IO
 static int createNonblocking()
@@ -20,14 +22,24 @@ static int createNonblocking()
     return sockfd;
 }
 
+// 预留的fd打不开时，暂停accept多久以后再试，秒
+static const double kIdleFdRetryInterval = 0.1;
+
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop)
     , acceptSocket_(createNonblocking()) // socket
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , acceptBatch_(64)
+    , paused_(false)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    , idleFdExhausted_(false)
+    , acceptedCount_(0)
+    , droppedCount_(0)
+    , errorCount_(0)
 {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr); // bind套接字
     // TcpServer::start() Acceptor.listen  有新用户的连接，要执行一个回调（connfd=》channel=》subloop）
     // baseLoop => acceptChannel_(listenfd) => 
@@ -36,41 +48,136 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
 
 Acceptor::~Acceptor()
 {
+    loop_->cancel(idleFdRetryTimer_);
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
 }
 
 void Acceptor::listen()
 {
     listenning_ = true; // 标记开始监听
-    acceptSocket_.listen(); // listen
-    acceptChannel_.enableReading(); // acceptChannel_ => Poller
+    acceptSocket_.applyListenOptions(options_);
+    acceptSocket_.listen(options_.listenBacklog); // listen
+    updateReading(); // acceptChannel_ => Poller
+}
+
+void Acceptor::pause()
+{
+    paused_ = true;
+    updateReading();
+}
+
+void Acceptor::resume()
+{
+    paused_ = false;
+    updateReading();
+}
+
+void Acceptor::updateReading()
+{
+    bool reading = listenning_ && !paused_ && !idleFdExhausted_;
+    if (reading && !acceptChannel_.isReading())
+    {
+        acceptChannel_.enableReading();
+    }
+    else if (!reading && acceptChannel_.isReading())
+    {
+        acceptChannel_.disableReading();
+    }
 }
 
 // listenfd有事件发生了，就是有新用户连接了
+// 一次把已完成握手的连接尽量取完（最多acceptBatch_个），突发连接不用每个都等一轮epoll_wait
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    // newConnectionCallback_里可能触发了准入控制而pause，剩下的连接留在队列里
+    for (int i = 0; i < acceptBatch_ && acceptChannel_.isReading(); ++i)
     {
-        if (newConnectionCallback_)
-        {
-            newConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
-        }
-        else
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
         {
-            // 如果没分发到，直接关闭
-            ::close(connfd);
+            ++acceptedCount_;
+            // fd刚刚有空余，趁机把之前没能打开的预留fd补上
+            if (idleFd_ < 0)
+            {
+                reopenIdleFd();
+            }
+            if (newConnectionCallback_)
+            {
+                newConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop，唤醒，分发当前的新客户端的Channel
+            }
+            else
+            {
+                // 如果没分发到，直接关闭
+                ::close(connfd);
+            }
+            continue;
         }
-    }
-    else
-    {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE)
+
+        int savedErrno = errno;
+        switch (savedErrno)
         {
+        case EAGAIN: // 全连接队列已经取空
+            return;
+        // 连接在accept之前就断开了，或者被信号打断，继续取下一个
+        case EINTR:
+        case ECONNABORTED:
+        case EPROTO:
+        case EPERM:
+            break;
+        case EMFILE:
+        case ENFILE:
             // 文件描述符到达上限
             LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            dropConnection();
+            break;
+        default:
+            ++errorCount_;
+            LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+            return;
         }
     }
-}
\ No newline at end of file
+}
+
+bool Acceptor::reopenIdleFd()
+{
+    if (idleFd_ < 0)
+    {
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    return idleFd_ >= 0;
+}
+
+void Acceptor::dropConnection()
+{
+    if (!reopenIdleFd())
+    {
+        // 没有fd可以用来接受并关闭连接，继续关注listenfd只会让loop空转，先停下来，定时重试
+        ++errorCount_;
+        idleFdExhausted_ = true;
+        updateReading();
+        idleFdRetryTimer_ = loop_->runAfter(kIdleFdRetryInterval, std::bind(&Acceptor::retryIdleFd, this));
+        return;
+    }
+    ::close(idleFd_);
+    idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+        ++droppedCount_;
+    }
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+void Acceptor::retryIdleFd()
+{
+    // 重新打开失败也恢复关注，连接还堆着的话handleRead会再走到dropConnection安排下一次重试
+    reopenIdleFd();
+    idleFdExhausted_ = false;
+    updateReading();
+}
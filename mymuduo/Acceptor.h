@@ -2,8 +2,12 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "SocketOptions.h"
+#include "TimerId.h"
 
 #include <functional>
+#include <atomic>
+#include <stdint.h>
 
 class EventLoop;
 class InetAddress;
@@ -23,14 +27,46 @@ public:
         newConnectionCallback_ = std::move(cb);
     }
 
+    // 监听socket的选项和backlog，在listen之前调用
+    void setSocketOptions(const SocketOptions &opts) { options_ = opts; }
+
+    // 每次listenfd可读时最多accept的连接数，默认64
+    void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+
     bool listenning() const { return listenning_; }
     void listen();
+
+    // 暂停/恢复关注listenfd的读事件，暂停期间新连接留在内核的全连接队列里，在loop线程调用
+    void pause();
+    void resume();
+    bool paused() const { return paused_; }
+
+    // 统计计数，可以在任意线程读取，定期采样相减就是accept速率
+    uint64_t acceptedCount() const { return acceptedCount_; }
+    uint64_t droppedCount() const { return droppedCount_; } // fd耗尽时被关闭的连接
+    uint64_t errorCount() const { return errorCount_; }
 private:
     void handleRead();
+    // fd耗尽时用预留的fd把连接接受下来立即关闭，否则listenfd一直可读，LT模式下loop空转
+    void dropConnection();
+    // 预留的fd没有打开时重新打开，返回是否可用
+    bool reopenIdleFd();
+    // 用户没有暂停、预留fd也可用时才关注listenfd的读事件
+    void updateReading();
+    void retryIdleFd();
     
     EventLoop *loop_; // Acceptor用的就是用户定义的那个baseLoop，也称作mainLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    SocketOptions options_;
+    int acceptBatch_;
+    bool paused_; // 用户调用了pause
+    int idleFd_; // 预留的/dev/null
+    bool idleFdExhausted_; // 预留的fd也打不开，暂停accept等定时器重试
+    TimerId idleFdRetryTimer_;
+    std::atomic<uint64_t> acceptedCount_;
+    std::atomic<uint64_t> droppedCount_;
+    std::atomic<uint64_t> errorCount_;
 };
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "AsyncLogging.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+namespace
+{
+
+void writeStdout(const char *data, size_t len)
+{
+    ::fwrite(data, 1, len, stdout);
+}
+
+void flushStdout()
+{
+    ::fflush(stdout);
+}
+
+} // namespace
+
+AsyncLogging::AsyncLogging(int flushInterval, size_t bufferSize, size_t maxPendingBuffers)
+    : flushInterval_(flushInterval)
+    , bufferSize_(bufferSize)
+    , maxPendingBuffers_(maxPendingBuffers)
+    , running_(false)
+    , dropped_(0)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "AsyncLogging")
+    , output_(writeStdout)
+    , flush_(flushStdout)
+    , currentBuffer_(new LogBuffer(bufferSize))
+    , nextBuffer_(new LogBuffer(bufferSize))
+    , flushRequested_(0)
+    , flushedRound_(0)
+{
+    buffers_.reserve(maxPendingBuffers_);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void AsyncLogging::append(const char *logline, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len);
+        return;
+    }
+
+    // current写满了，交给后台；积压太多说明后台写不动了，丢掉这一行，不能让loop线程卡在这里
+    if (buffers_.size() >= maxPendingBuffers_)
+    {
+        ++dropped_;
+        return;
+    }
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_.reset(new LogBuffer(bufferSize_)); // 很少发生，前端写得太快
+    }
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len);
+    }
+    else
+    {
+        ++dropped_; // 一行比整个缓冲区还大
+    }
+    cond_.notify_one();
+}
+
+void AsyncLogging::flush()
+{
+    if (!running_)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t round = ++flushRequested_;
+    cond_.notify_one();
+    // 最多等一个flushInterval，后台线程卡住时也不能让调用方一直等
+    flushedCond_.wait_for(lock, std::chrono::seconds(flushInterval_ + 1),
+                          [this, round]() { return flushedRound_ >= round || !running_; });
+}
+
+void AsyncLogging::threadFunc()
+{
+    // 后台线程自己的两块备用缓冲区，换给前端，避免前端分配内存
+    BufferPtr newBuffer1(new LogBuffer(bufferSize_));
+    BufferPtr newBuffer2(new LogBuffer(bufferSize_));
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(maxPendingBuffers_ + 1);
+
+    while (true)
+    {
+        uint64_t round = 0;
+        bool running = true;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && flushRequested_ == flushedRound_ && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            // 不管current满没满都换走，保证日志最多延迟flushInterval秒
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+            round = flushRequested_;
+            running = running_;
+        }
+
+        size_t dropped = dropped_.exchange(0);
+        if (dropped > 0)
+        {
+            char buf[128];
+            int len = snprintf(buf, sizeof buf, "[ERROR]AsyncLogging dropped %zu log lines, backend too slow\n", dropped);
+            output_(buf, len);
+        }
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            if (buffer->length() > 0)
+            {
+                output_(buffer->data(), buffer->length());
+            }
+        }
+        flush_();
+
+        // 留两块缓冲区给下一轮用，其余的释放
+        if (buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2 && !buffersToWrite.empty())
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            flushedRound_ = round;
+        }
+        flushedCond_.notify_all();
+
+        if (!running)
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * 异步日志后端，双缓冲：
+ * 前端线程（各个loop线程）调用append，只是把日志拷贝进预先分配好的大缓冲区，
+ * 后台线程定期或者缓冲区写满时把整块缓冲区换走，在锁外面一次性写出去
+ * 后台写不过来、积压的缓冲区超过maxPendingBuffers时直接丢弃新日志并计数，不阻塞loop线程
+ * 
+ * 用法：
+ *   AsyncLogging async;
+ *   async.start();
+ *   Logger::instance().setOutput(std::bind(&AsyncLogging::append, &async, _1, _2));
+ *   Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &async));
+ */ 
+class AsyncLogging : noncopyable
+{
+public:
+    using OutputFunc = std::function<void(const char *data, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
+    explicit AsyncLogging(int flushInterval = 3,
+                          size_t bufferSize = 4 * 1024 * 1024,
+                          size_t maxPendingBuffers = 16);
+    ~AsyncLogging();
+
+    // 后台线程写日志的目的地，默认写stdout，需要在start之前设置
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
+
+    // 前端接口，线程安全
+    void append(const char *logline, size_t len);
+    // 把已经append的日志全部写出去再返回，FATAL退出前使用
+    void flush();
+
+    void start();
+    void stop();
+private:
+    // 一块预先分配的日志缓冲区
+    class LogBuffer : noncopyable
+    {
+    public:
+        explicit LogBuffer(size_t size) : data_(new char[size]), size_(size), len_(0) {}
+
+        size_t avail() const { return size_ - len_; }
+        void append(const char *buf, size_t len) { ::memcpy(data_.get() + len_, buf, len); len_ += len; }
+        const char* data() const { return data_.get(); }
+        size_t length() const { return len_; }
+        void reset() { len_ = 0; }
+    private:
+        std::unique_ptr<char[]> data_;
+        const size_t size_;
+        size_t len_;
+    };
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+
+    const int flushInterval_; // 秒
+    const size_t bufferSize_;
+    const size_t maxPendingBuffers_;
+    std::atomic_bool running_;
+    std::atomic<size_t> dropped_; // 上一轮以来因为后台积压被丢弃的日志条数，后台写出时打印一条提示
+    Thread thread_;
+
+    OutputFunc output_;
+    FlushFunc flush_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_; // 通知后台线程有写满的缓冲区
+    std::condition_variable flushedCond_; // 通知flush调用者后台写完了一轮
+    BufferPtr currentBuffer_; // 前端正在写的缓冲区
+    BufferPtr nextBuffer_; // 备用缓冲区，current写满时直接换上，不用分配
+    BufferVector buffers_; // 写满等待后台写出的缓冲区
+    uint64_t flushRequested_; // flush请求的轮次
+    uint64_t flushedRound_; // 后台已经写完的轮次
+};
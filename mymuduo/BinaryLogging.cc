@@ -0,0 +1,262 @@
+#include "BinaryLogging.h"
+
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <unistd.h>
+
+namespace binlog
+{
+
+LogRing::LogRing(size_t capacity)
+    : buffer_(new char[capacity]) // 不清零
+    , capacity_(capacity)
+    , mask_(capacity - 1)
+    , writePos_(0)
+    , cachedReadPos_(0)
+    , pendingPad_(0)
+    , readPos_(0)
+    , dropped_(0)
+    , retired_(false)
+{
+}
+
+void* LogRing::operator new(size_t size)
+{
+    void *p = nullptr;
+    if (::posix_memalign(&p, 64, size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void LogRing::operator delete(void *p)
+{
+    ::free(p);
+}
+
+namespace
+{
+
+__thread LogRing *t_ring = nullptr;
+__thread bool t_ringRetired = false;
+
+// 线程退出时把环形缓冲区标记为退役，由后台线程读空以后释放
+struct RingHolder
+{
+    LogRing *ring = nullptr;
+    ~RingHolder()
+    {
+        if (ring != nullptr)
+        {
+            ring->retire();
+        }
+        // 之后线程退出过程中再打的日志直接丢弃，不能再写进已经退役的环形缓冲区
+        t_ring = nullptr;
+        t_ringRetired = true;
+    }
+};
+
+} // namespace
+
+LogRing* threadRing()
+{
+    if (t_ring == nullptr)
+    {
+        if (t_ringRetired)
+        {
+            return nullptr;
+        }
+        // 只有每个线程第一次打日志时走到这里，平时只读一个__thread指针
+        static thread_local RingHolder holder;
+        holder.ring = BinaryLogging::instance().registerThread();
+        t_ring = holder.ring;
+    }
+    return t_ring;
+}
+
+} // namespace binlog
+
+namespace
+{
+
+void writeStdout(const char *data, size_t len)
+{
+    ::fwrite(data, 1, len, stdout);
+    ::fflush(stdout);
+}
+
+const char* levelName(int level)
+{
+    switch (level)
+    {
+    case TRACE: return "[TRACE]";
+    case DEBUG: return "[DEBUG]";
+    case INFO: return "[INFO]";
+    case ERROR: return "[ERROR]";
+    case FATAL: return "[FATAL]";
+    default: return "";
+    }
+}
+
+const size_t kMaxPendingBytes = 64 * 1024; // 攒够这么多再输出一次
+
+} // namespace
+
+BinaryLogging& BinaryLogging::instance()
+{
+    static BinaryLogging logging;
+    return logging;
+}
+
+BinaryLogging::BinaryLogging()
+    : ringSize_(1024 * 1024)
+    , pollIntervalMs_(1)
+    , running_(false)
+    , output_(writeStdout)
+{
+    pending_.reserve(kMaxPendingBytes + 1024);
+}
+
+BinaryLogging::~BinaryLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void BinaryLogging::setRingSize(size_t bytes)
+{
+    size_t size = 4096;
+    while (size < bytes)
+    {
+        size <<= 1;
+    }
+    ringSize_ = size;
+}
+
+binlog::LogRing* BinaryLogging::registerThread()
+{
+    binlog::LogRing *ring = new binlog::LogRing(ringSize_);
+    std::unique_lock<std::mutex> lock(ringsMutex_);
+    rings_.emplace_back(ring);
+    return ring;
+}
+
+void BinaryLogging::start(int pollIntervalMs)
+{
+    pollIntervalMs_ = pollIntervalMs;
+    running_ = true;
+    thread_.reset(new Thread(std::bind(&BinaryLogging::threadFunc, this), "BinaryLogging"));
+    thread_->start();
+}
+
+void BinaryLogging::stop()
+{
+    running_ = false;
+    // 没有start过或者已经stop过时没有后台线程，只把剩下的日志输出
+    if (thread_)
+    {
+        thread_->join();
+        thread_.reset();
+    }
+    flush();
+}
+
+void BinaryLogging::flush()
+{
+    drain();
+}
+
+void BinaryLogging::threadFunc()
+{
+    while (running_)
+    {
+        if (drain() == 0)
+        {
+            // 没有日志时短暂睡眠，不让生产者承担唤醒的开销
+            ::usleep(pollIntervalMs_ * 1000);
+        }
+    }
+}
+
+size_t BinaryLogging::drain()
+{
+    std::unique_lock<std::mutex> drainLock(drainMutex_);
+
+    // 先拿到当前所有的环形缓冲区，格式化在ringsMutex_外面做，不挡住新线程注册
+    std::vector<binlog::LogRing*> rings;
+    {
+        std::unique_lock<std::mutex> lock(ringsMutex_);
+        rings.reserve(rings_.size());
+        for (const std::unique_ptr<binlog::LogRing> &ring : rings_)
+        {
+            rings.push_back(ring.get());
+        }
+    }
+
+    size_t count = 0;
+    for (binlog::LogRing *ring : rings)
+    {
+        count += ring->consume([this](const binlog::RecordHeader &header, const char *args) {
+            formatRecord(header, args);
+        });
+        size_t dropped = ring->takeDropped();
+        if (dropped > 0)
+        {
+            char buf[128];
+            int len = snprintf(buf, sizeof buf, "[ERROR]BinaryLogging dropped %zu log lines, ring full\n", dropped);
+            pending_.append(buf, len);
+        }
+    }
+    if (!pending_.empty())
+    {
+        output_(pending_.data(), pending_.size());
+        pending_.clear();
+    }
+
+    // 线程已经退出而且读空了的环形缓冲区可以释放了
+    {
+        std::unique_lock<std::mutex> lock(ringsMutex_);
+        for (size_t i = 0; i < rings_.size(); )
+        {
+            if (rings_[i]->retired() && rings_[i]->empty())
+            {
+                rings_[i] = std::move(rings_.back());
+                rings_.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+    return count;
+}
+
+void BinaryLogging::formatRecord(const binlog::RecordHeader &header, const char *args)
+{
+    // [级别信息] time : msg，和Logger的格式一致，时间精确到微秒
+    char timebuf[32];
+    Timestamp(header.microSecondsSinceEpoch).formatTo(timebuf, sizeof timebuf);
+    char line[1280];
+    int len = snprintf(line, sizeof line, "%s%s : ", levelName(header.info->level), timebuf);
+    int n = header.decode(header.info->format, args, line + len, sizeof line - len - 1);
+    if (n < 0)
+    {
+        n = 0;
+    }
+    len += std::min(n, static_cast<int>(sizeof line - len - 2));
+    line[len++] = '\n';
+    pending_.append(line, len);
+
+    if (pending_.size() >= kMaxPendingBytes)
+    {
+        output_(pending_.data(), pending_.size());
+        pending_.clear();
+    }
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Logger.h"
+#include "Thread.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * 二进制日志（延迟格式化），参考NanoLog：
+ * 调用点只把格式串的静态信息指针、解码函数指针、时间戳和原始参数写进本线程的无锁环形缓冲区（单生产者单消费者），
+ * snprintf由后台线程完成，调用点的开销只有几十纳秒，连接级别的详细日志可以在线上一直开着
+ * 
+ * 用法：
+ *   BinaryLogging::instance().start();
+ *   LOG_BIN_INFO("conn %s recv %lu bytes", conn->name().c_str(), n);
+ * 
+ * 参数支持整数、浮点、枚举、指针和C字符串（字符串会被拷贝），std::string请传c_str()
+ * 级别过滤和LOG_XXX一样，先比较编译期下限和Logger的运行期阈值
+ * 环形缓冲区满了直接丢弃日志并计数，不会阻塞调用线程
+ */ 
+
+namespace binlog
+{
+
+// 每个调用点一个静态对象，地址就是这条格式串的id
+struct FormatInfo
+{
+    int level;
+    const char *format;
+    const char *file;
+    int line;
+};
+
+// 后台线程用它把参数还原出来再格式化，每种参数类型组合实例化一个
+using DecodeFunc = int (*)(const char *format, const char *args, char *out, size_t outLen);
+
+// 环形缓冲区里每条记录的头，后面紧跟编码好的参数，整条记录按8字节对齐
+// info为nullptr表示这是回绕时填充的空白
+struct RecordHeader
+{
+    uint32_t size; // 包括头在内的整条记录长度
+    uint32_t reserved;
+    const FormatInfo *info;
+    DecodeFunc decode;
+    int64_t microSecondsSinceEpoch;
+};
+
+/**
+ * 每个线程一个的环形缓冲区，只有所属线程写，只有后台线程读
+ * 读写位置都是单调增长的字节数，取模得到下标；一条记录必须连续存放，尾部放不下时跳到开头
+ */ 
+class LogRing : noncopyable
+{
+public:
+    explicit LogRing(size_t capacity);
+
+    // C++11的new不理会alignas(64)，自己按cache line对齐分配，保证读写位置真的在不同的cache line上
+    static void* operator new(size_t size);
+    static void operator delete(void *p);
+
+    // 生产者：预留n字节，空间不够返回nullptr（这条日志被丢弃）
+    char* reserve(size_t n)
+    {
+        uint64_t w = writePos_.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(w & mask_);
+        size_t pad = offset + n > capacity_ ? capacity_ - offset : 0;
+        if (w + pad + n - cachedReadPos_ > capacity_)
+        {
+            cachedReadPos_ = readPos_.load(std::memory_order_acquire);
+            if (n > capacity_ / 4 || w + pad + n - cachedReadPos_ > capacity_)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        if (pad >= sizeof(RecordHeader))
+        {
+            // 尾部剩下的空间足够放一个头，写一个空白记录告诉消费者跳过去
+            RecordHeader blank;
+            blank.size = static_cast<uint32_t>(pad);
+            blank.info = nullptr;
+            ::memcpy(buffer_.get() + offset, &blank, sizeof blank);
+        }
+        pendingPad_ = pad;
+        return buffer_.get() + ((w + pad) & mask_);
+    }
+    // 生产者：记录写完了，发布给消费者
+    void commit(size_t n)
+    {
+        uint64_t w = writePos_.load(std::memory_order_relaxed);
+        writePos_.store(w + pendingPad_ + n, std::memory_order_release);
+    }
+
+    // 消费者：处理所有已经发布的记录，返回处理的条数
+    template <typename Func>
+    size_t consume(Func func)
+    {
+        uint64_t r = readPos_.load(std::memory_order_relaxed);
+        const uint64_t w = writePos_.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (r < w)
+        {
+            size_t offset = static_cast<size_t>(r & mask_);
+            if (capacity_ - offset < sizeof(RecordHeader))
+            {
+                r += capacity_ - offset; // 放不下头的尾巴，生产者什么也没写
+                continue;
+            }
+            RecordHeader header;
+            ::memcpy(&header, buffer_.get() + offset, sizeof header);
+            if (header.info != nullptr)
+            {
+                func(header, buffer_.get() + offset + sizeof header);
+                ++count;
+            }
+            r += header.size;
+        }
+        readPos_.store(r, std::memory_order_release);
+        return count;
+    }
+
+    size_t takeDropped() { return dropped_.exchange(0, std::memory_order_relaxed); }
+
+    // 线程退出以后标记，后台线程读空以后释放
+    void retire() { retired_.store(true, std::memory_order_release); }
+    bool retired() const { return retired_.load(std::memory_order_acquire); }
+    bool empty() const
+    { return readPos_.load(std::memory_order_acquire) == writePos_.load(std::memory_order_acquire); }
+private:
+    std::unique_ptr<char[]> buffer_;
+    const size_t capacity_; // 2的幂
+    const uint64_t mask_;
+
+    // 生产者和消费者各自的位置放在不同的cache line上，避免伪共享
+    alignas(64) std::atomic<uint64_t> writePos_;
+    uint64_t cachedReadPos_; // 生产者缓存的读位置，空间够用时不用访问readPos_
+    size_t pendingPad_;
+
+    alignas(64) std::atomic<uint64_t> readPos_;
+    std::atomic<size_t> dropped_;
+    std::atomic_bool retired_;
+};
+
+// 参数的编码：算术类型和枚举按原样拷贝，指针按void*保存，C字符串保存长度和内容（包括结尾的0）
+template <typename T>
+struct ArgTraits
+{
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                  "binary log arguments must be arithmetic, enum, pointer or C string");
+    using Stored = T;
+    static size_t size(T) { return sizeof(T); }
+    static char* encode(char *p, T v) { ::memcpy(p, &v, sizeof v); return p + sizeof v; }
+};
+
+template <typename T>
+struct ArgTraits<T*>
+{
+    using Stored = const void*;
+    static size_t size(T*) { return sizeof(Stored); }
+    static char* encode(char *p, T *v) { Stored s = v; ::memcpy(p, &s, sizeof s); return p + sizeof s; }
+};
+
+struct StringArgTraits
+{
+    using Stored = const char*;
+    static size_t size(const char *s) { return sizeof(uint32_t) + (s ? ::strlen(s) : 0) + 1; }
+    static char* encode(char *p, const char *s)
+    {
+        uint32_t len = s ? static_cast<uint32_t>(::strlen(s)) : 0;
+        ::memcpy(p, &len, sizeof len);
+        ::memcpy(p + sizeof len, s ? s : "", len + 1);
+        return p + sizeof len + len + 1;
+    }
+};
+template <> struct ArgTraits<char*> : StringArgTraits {};
+template <> struct ArgTraits<const char*> : StringArgTraits {};
+
+// 参数的解码：按保存的类型还原，字符串直接指向环形缓冲区里的内容
+template <typename T>
+inline const char* decodeArg(const char *p, T *v)
+{
+    ::memcpy(v, p, sizeof *v);
+    return p + sizeof *v;
+}
+
+template <>
+inline const char* decodeArg<const char*>(const char *p, const char **v)
+{
+    uint32_t len;
+    ::memcpy(&len, p, sizeof len);
+    *v = p + sizeof len;
+    return p + sizeof len + len + 1;
+}
+
+inline size_t argsSize() { return 0; }
+template <typename T, typename... Rest>
+inline size_t argsSize(const T &first, const Rest&... rest)
+{
+    return ArgTraits<typename std::decay<T>::type>::size(first) + argsSize(rest...);
+}
+
+inline char* encodeArgs(char *p) { return p; }
+template <typename T, typename... Rest>
+inline char* encodeArgs(char *p, const T &first, const Rest&... rest)
+{
+    return encodeArgs(ArgTraits<typename std::decay<T>::type>::encode(p, first), rest...);
+}
+
+template <size_t I, typename Tuple>
+inline typename std::enable_if<I == std::tuple_size<Tuple>::value>::type
+decodeArgs(const char*, Tuple&) {}
+
+template <size_t I, typename Tuple>
+inline typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type
+decodeArgs(const char *p, Tuple &values)
+{
+    decodeArgs<I + 1>(decodeArg(p, &std::get<I>(values)), values);
+}
+
+// C++11没有std::index_sequence，自己实现一个
+template <size_t... I> struct IndexSequence {};
+template <size_t N, size_t... I> struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndexSequence<0, I...> { using type = IndexSequence<I...>; };
+
+template <typename Tuple, size_t... I>
+inline int formatTuple(const char *format, char *out, size_t outLen, const Tuple &values, IndexSequence<I...>)
+{
+    return ::snprintf(out, outLen, format, std::get<I>(values)...);
+}
+
+// 后台线程调用：把参数解码进tuple，再交给snprintf
+template <typename... Args>
+int decodeRecord(const char *format, const char *args, char *out, size_t outLen)
+{
+    std::tuple<typename ArgTraits<typename std::decay<Args>::type>::Stored...> values;
+    decodeArgs<0>(args, values);
+    return formatTuple(format, out, outLen, values, typename MakeIndexSequence<sizeof...(Args)>::type());
+}
+
+// 本线程的环形缓冲区，第一次使用时向BinaryLogging注册；线程退出过程中已经退役的返回nullptr
+LogRing* threadRing();
+
+// 调用点：编码写入本线程的环形缓冲区
+template <typename... Args>
+inline void log(const FormatInfo &info, const Args&... args)
+{
+    size_t size = (sizeof(RecordHeader) + argsSize(args...) + 7) & ~static_cast<size_t>(7);
+    LogRing *ring = threadRing();
+    char *p = ring != nullptr ? ring->reserve(size) : nullptr;
+    if (p == nullptr)
+    {
+        return;
+    }
+    RecordHeader header;
+    header.size = static_cast<uint32_t>(size);
+    header.reserved = 0;
+    header.info = &info;
+    header.decode = &decodeRecord<Args...>;
+    header.microSecondsSinceEpoch = Timestamp::now().microSecondsSinceEpoch();
+    ::memcpy(p, &header, sizeof header);
+    encodeArgs(p + sizeof header, args...);
+    ring->commit(size);
+}
+
+// 只用来让编译器检查格式串和参数是否匹配，永远不会被调用
+inline void checkFormat(const char*, ...) __attribute__((format(printf, 1, 2)));
+inline void checkFormat(const char*, ...) {}
+
+} // namespace binlog
+
+// 二进制日志的后端：收集所有线程的环形缓冲区，在后台线程里格式化并输出
+class BinaryLogging : noncopyable
+{
+public:
+    using OutputFunc = std::function<void(const char *data, size_t len)>;
+
+    static BinaryLogging& instance();
+
+    // 每个线程环形缓冲区的大小，向上取整到2的幂，只影响之后第一次打日志的线程
+    void setRingSize(size_t bytes);
+    // 格式化好的日志写到哪里，默认stdout，可以接AsyncLogging::append；需要在start之前设置
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+
+    // 后台线程没有日志可读时睡眠pollIntervalMs毫秒
+    void start(int pollIntervalMs = 1);
+    void stop();
+    // 在调用线程里把所有环形缓冲区读空
+    void flush();
+
+    binlog::LogRing* registerThread();
+private:
+    BinaryLogging();
+    ~BinaryLogging();
+
+    void threadFunc();
+    // 读空所有环形缓冲区，返回处理的日志条数
+    size_t drain();
+    void formatRecord(const binlog::RecordHeader &header, const char *args);
+
+    std::atomic<size_t> ringSize_;
+    int pollIntervalMs_;
+    std::atomic_bool running_;
+    std::unique_ptr<Thread> thread_;
+    OutputFunc output_;
+
+    std::mutex ringsMutex_; // 保护rings_，注册新线程时和后台线程竞争
+    std::vector<std::unique_ptr<binlog::LogRing>> rings_;
+    std::mutex drainMutex_; // 保证每个环形缓冲区同一时刻只有一个消费者
+    std::string pending_; // 攒一批格式化好的日志再输出
+};
+
+#define LOG_BINARY(level, logmsgFormat, ...) \
+    do \
+    { \
+        if (level >= MYMUDUO_LOG_FLOOR && Logger::instance().logLevel() <= level) \
+        { \
+            if (false) \
+            { \
+                binlog::checkFormat(logmsgFormat, ##__VA_ARGS__); \
+            } \
+            static const binlog::FormatInfo binlogFormatInfo = { level, logmsgFormat, __FILE__, __LINE__ }; \
+            binlog::log(binlogFormatInfo, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#define LOG_BIN_TRACE(logmsgFormat, ...) LOG_BINARY(TRACE, logmsgFormat, ##__VA_ARGS__)
+#define LOG_BIN_DEBUG(logmsgFormat, ...) LOG_BINARY(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define LOG_BIN_INFO(logmsgFormat, ...) LOG_BINARY(INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_BIN_ERROR(logmsgFormat, ...) LOG_BINARY(ERROR, logmsgFormat, ##__VA_ARGS__)
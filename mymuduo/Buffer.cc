@@ -2,17 +2,84 @@
 
 #include <errno.h>
 #include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <string.h>
 #include <unistd.h>
 
+const size_t Buffer::kCheapPrepend;
+const size_t Buffer::kInitialSize;
+const size_t Buffer::kMaxReadHint;
+
+namespace
+{
+// 在[begin, end)中查找字节c；glibc的memchr运行时按CPU选择AVX2/EVEX实现，不需要自己写SIMD
+const char* scanByte(const char *begin, const char *end, char c)
+{
+    return static_cast<const char*>(::memchr(begin, c, end - begin));
+}
+}
+
+const char* Buffer::findByte(char c) const
+{
+    return scanByte(peek(), beginWrite(), c);
+}
+
+const char* Buffer::findCRLF() const
+{
+    const char *start = peek() + crlfScanned_;
+    const char *end = beginWrite();
+    // 找'\n'再看前一个字节是不是'\r'，这样'\r'刚好落在上一次扫描末尾的情况也不会漏掉
+    while (start < end)
+    {
+        const char *lf = scanByte(start, end, '\n');
+        if (lf == nullptr)
+        {
+            break;
+        }
+        if (lf > peek() && lf[-1] == '\r')
+        {
+            crlfScanned_ = lf - 1 - peek();
+            return lf - 1;
+        }
+        start = lf + 1;
+    }
+    crlfScanned_ = readableBytes();
+    return nullptr;
+}
+
+const char* Buffer::findEOL() const
+{
+    const char *eol = scanByte(peek() + eolScanned_, beginWrite(), '\n');
+    eolScanned_ = eol == nullptr ? readableBytes() : eol - peek();
+    return eol;
+}
+
 /**
  * 从fd上读取数据  Poller工作在LT模式
  * Buffer缓冲区是有大小的！ 但是从fd上读数据的时候，却不知道tcp数据最终的大小
+ * 
+ * extrabuf是每个EventLoop持有的一块溢出区，多个连接复用，不用每次都在栈上清零64K
  */ 
-ssize_t Buffer::readFd(int fd, int* saveErrno)
+ssize_t Buffer::readFd(int fd, int* saveErrno, char* extrabuf, size_t extrabufLen, size_t maxBytes)
 {
-    // 引入这个结构，确保不会丢失数据
-    char extrabuf[65536] = {0}; // 栈上的内存空间  64K, 出作用域会自动消亡
-    
+    // 上一次把Buffer和溢出区都读满了，用FIONREAD问一下内核还有多少数据，一次性把Buffer扩够，
+    // 让readv直接读进Buffer，省掉溢出区再拷贝一次
+    // 只在socket里确实还堆着数据时扩容，扩出来的空间这次就会被填上；突发过去以后不再按历史读取量扩容，
+    // 否则大量连接每个都留着一块用不上的大Buffer，小读取仍然走loop共享的溢出区
+    if (lastReadFull_)
+    {
+        int available = 0;
+        if (::ioctl(fd, FIONREAD, &available) == 0 && available > 0)
+        {
+            readHint_ = std::max(readHint_, std::min(static_cast<size_t>(available), kMaxReadHint));
+        }
+        const size_t want = std::min(readHint_, maxBytes);
+        if (want > writeableBytes())
+        {
+            ensureWriteableBytes(want);
+        }
+    }
+
     // struct iovec {
     //     void  *iov_base;    /* Starting address */
     //     size_t iov_len;     /* Number of bytes to transfer */
@@ -20,7 +87,7 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     
     struct iovec vec[2];
     
-    const size_t writable = writeableBytes(); // 这是Buffer底层缓冲区剩余的可写空间大小
+    const size_t writable = std::min(writeableBytes(), maxBytes); // 这是Buffer底层缓冲区剩余的可写空间大小
     
     // 指向Buffer中可写入的位置,注意我们用的都是下标来实现的
     vec[0].iov_base = begin() + writerIndex_;
@@ -29,45 +96,56 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     
     // 表示Buffer中已经写满，没有位置给你写, 所以其他数据都存在extrabuf中
     vec[1].iov_base = extrabuf;
-    // 获取extrabuf的长度，也就是64KB
-    vec[1].iov_len = sizeof extrabuf;
+    vec[1].iov_len = std::min(extrabufLen, maxBytes - writable);
     
     /*
-        1:如果writable确实小于sizeof extrabuf，这意味着Buffer的剩余空间不足以
+        1:如果writable确实小于extrabufLen，这意味着Buffer的剩余空间不足以
         接收所有可能从文件描述符读取的数据。在这种情况下，readv应该使用两个iovec
         结构：第一个是Buffer的剩余部分，第二个是extrabuf。因此，iovcnt被设置为2。
 
-        2:如果writable不小于sizeof extrabuf，这意味着Buffer有足够的空间来接收所
+        2:如果writable不小于extrabufLen，这意味着Buffer有足够的空间来接收所
         有可能读取的数据，无需使用extrabuf。在这种情况下，readv只需要使用一个iovec
         结构，即Buffer本身。因此，iovcnt被设置为1
     */
-
-
-    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+    const int iovcnt = (writable < extrabufLen && vec[1].iov_len > 0) ? 2 : 1;
 
     // 调用readv函数从fd读取数据到vec指定的多个缓冲区中
     const ssize_t n = ::readv(fd, vec, iovcnt);
     if (n < 0)
     {
         *saveErrno = errno;
+        return n;
     }
-    else if (n <= writable) // Buffer的可写缓冲区已经够存储读出来的数据了
+
+    const size_t nread = static_cast<size_t>(n);
+    if (nread <= writable) // Buffer的可写缓冲区已经够存储读出来的数据了
     {
-        writerIndex_ += n;
+        writerIndex_ += nread;
     }
     else // extrabuf里面也写入了数据 
     {
         writerIndex_ = buffer_.size();
-        append(extrabuf, n - writable);  // writerIndex_开始写 n - writable大小的数据
+        append(extrabuf, nread - writable);  // writerIndex_开始写 n - writable大小的数据
     }
 
+    // 读取量变大立即跟上，变小则减半衰减，小消息的连接不会一直占着大Buffer的预期
+    lastReadFull_ = (iovcnt == 2 && nread == writable + vec[1].iov_len);
+    readHint_ = nread > readHint_ ? std::min(nread, kMaxReadHint) : (readHint_ + nread) / 2;
+
     return n;
 }
 
+ssize_t Buffer::readFd(int fd, int* saveErrno)
+{
+    // 线程局部的溢出区，只在线程启动时分配一次，不在每次读的时候清零
+    static __thread char t_extrabuf[65536];
+    return readFd(fd, saveErrno, t_extrabuf, sizeof t_extrabuf);
+}
+
 // 将缓冲区的数据写进套接字中
-ssize_t Buffer::writeFd(int fd, int* saveErrno)
+ssize_t Buffer::writeFd(int fd, int* saveErrno, size_t maxBytes)
 {
-    ssize_t n = ::write(fd, peek(), readableBytes());
+    ssize_t n = ::write(fd, peek(), std::min(readableBytes(), maxBytes));
     if (n < 0)
     {
         *saveErrno = errno;
@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
 
 // 网络库底层的缓冲器类型定义
 class Buffer
@@ -10,6 +13,7 @@ class Buffer
 public:
     static const size_t kCheapPrepend = 8; // 初始的下标的位置，这部分大小是预留的
     static const size_t kInitialSize = 1024; // 缓冲区的初始大小，整体需要加8字节
+    static const size_t kMaxReadHint = 1024 * 1024; // 按读取量预先扩容的上限，防止单个连接无限膨胀
 
     // 初始的buffer大小就是1032
     // 读写下标都从8字节的位置开始
@@ -18,8 +22,24 @@ public:
         : buffer_(kCheapPrepend + initialSize)
         , readerIndex_(kCheapPrepend)
         , writerIndex_(kCheapPrepend)
+        , readHint_(0)
+        , lastReadFull_(false)
+        , crlfScanned_(0)
+        , eolScanned_(0)
     {}
 
+    // 交换两个Buffer的底层存储，用于把整块数据的所有权转移给另一个Buffer
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+        std::swap(readHint_, rhs.readHint_);
+        std::swap(lastReadFull_, rhs.lastReadFull_);
+        std::swap(crlfScanned_, rhs.crlfScanned_);
+        std::swap(eolScanned_, rhs.eolScanned_);
+    }
+
     // 可读的数据数据长度
     size_t readableBytes() const 
     {
@@ -51,6 +71,9 @@ public:
         if (len < readableBytes())
         {
             readerIndex_ += len; // 应用只读取了刻度缓冲区数据的一部分，就是len，还剩下readerIndex_ += len -> writerIndex_
+            // 扫描位置是相对读下标记录的，跟着往前挪
+            crlfScanned_ = crlfScanned_ > len ? crlfScanned_ - len : 0;
+            eolScanned_ = eolScanned_ > len ? eolScanned_ - len : 0;
         }
         // 读取了缓冲区的所有数据
         // 然后进行复位操作
@@ -64,8 +87,23 @@ public:
     {
         readerIndex_ = kCheapPrepend;
         writerIndex_ = kCheapPrepend;
+        crlfScanned_ = 0;
+        eolScanned_ = 0;
+    }
+
+    // 取出直到end（不含end）为止的数据，end一般是findCRLF/findEOL的返回值
+    void retrieveUntil(const char *end)
+    {
+        retrieve(end - peek());
     }
 
+    // 在可读区域里查找字节c，找不到返回nullptr
+    const char* findByte(char c) const;
+    // 查找"\r\n"，返回指向'\r'的指针；会记住上一次扫描到的位置，数据没收全时反复调用不会重复扫描旧数据
+    const char* findCRLF() const;
+    // 查找'\n'，同样会记住上一次扫描到的位置
+    const char* findEOL() const;
+
     // 把onMessage函数上报的Buffer数据，转成string类型的数据返回
     std::string retrieveAllAsString()
     {
@@ -79,6 +117,87 @@ public:
         return result;
     }
 
+    // 以下整数接口都按网络字节序（大端）读写，协议编解码直接使用，不需要先拷贝成string
+    void appendInt64(int64_t x)
+    {
+        int64_t be64 = static_cast<int64_t>(htobe64(static_cast<uint64_t>(x)));
+        append(reinterpret_cast<const char*>(&be64), sizeof be64);
+    }
+    void appendInt32(int32_t x)
+    {
+        int32_t be32 = static_cast<int32_t>(htobe32(static_cast<uint32_t>(x)));
+        append(reinterpret_cast<const char*>(&be32), sizeof be32);
+    }
+    void appendInt16(int16_t x)
+    {
+        int16_t be16 = static_cast<int16_t>(htobe16(static_cast<uint16_t>(x)));
+        append(reinterpret_cast<const char*>(&be16), sizeof be16);
+    }
+    void appendInt8(int8_t x)
+    {
+        append(reinterpret_cast<const char*>(&x), sizeof x);
+    }
+
+    // 查看可读区域开头的整数，不移动读下标，调用方保证readableBytes()足够
+    int64_t peekInt64() const
+    {
+        uint64_t be64 = 0;
+        ::memcpy(&be64, peek(), sizeof be64);
+        return static_cast<int64_t>(be64toh(be64));
+    }
+    int32_t peekInt32() const
+    {
+        uint32_t be32 = 0;
+        ::memcpy(&be32, peek(), sizeof be32);
+        return static_cast<int32_t>(be32toh(be32));
+    }
+    int16_t peekInt16() const
+    {
+        uint16_t be16 = 0;
+        ::memcpy(&be16, peek(), sizeof be16);
+        return static_cast<int16_t>(be16toh(be16));
+    }
+    int8_t peekInt8() const
+    {
+        return static_cast<int8_t>(*peek());
+    }
+
+    // 读出整数并移动读下标
+    int64_t readInt64() { int64_t x = peekInt64(); retrieve(sizeof x); return x; }
+    int32_t readInt32() { int32_t x = peekInt32(); retrieve(sizeof x); return x; }
+    int16_t readInt16() { int16_t x = peekInt16(); retrieve(sizeof x); return x; }
+    int8_t readInt8() { int8_t x = peekInt8(); retrieve(sizeof x); return x; }
+
+    // 往可读数据的前面插入数据，用的是kCheapPrepend预留的空间，比如先写消息体再补长度头
+    void prepend(const void *data, size_t len)
+    {
+        // 调用方保证 len <= prependableBytes()
+        readerIndex_ -= len;
+        crlfScanned_ += len;
+        eolScanned_ += len;
+        const char *d = static_cast<const char*>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+    void prependInt64(int64_t x)
+    {
+        int64_t be64 = static_cast<int64_t>(htobe64(static_cast<uint64_t>(x)));
+        prepend(&be64, sizeof be64);
+    }
+    void prependInt32(int32_t x)
+    {
+        int32_t be32 = static_cast<int32_t>(htobe32(static_cast<uint32_t>(x)));
+        prepend(&be32, sizeof be32);
+    }
+    void prependInt16(int16_t x)
+    {
+        int16_t be16 = static_cast<int16_t>(htobe16(static_cast<uint16_t>(x)));
+        prepend(&be16, sizeof be16);
+    }
+    void prependInt8(int8_t x)
+    {
+        prepend(&x, sizeof x);
+    }
+
     // 往缓冲区写数据
     // buffer_.size() - writerIndex_    len
     /* 
@@ -102,6 +221,12 @@ public:
         writerIndex_ += len;
     }
 
+    // 直接往beginWrite()写入len字节以后，移动写下标
+    void hasWritten(size_t len)
+    {
+        writerIndex_ += len;
+    }
+
     char* beginWrite()
     {
         return begin() + writerIndex_;
@@ -112,10 +237,14 @@ public:
         return begin() + writerIndex_;
     }
 
-    // 从fd上读取数据
+    // 从fd上读取数据, extrabuf是调用方提供的溢出区(EventLoop持有的那一块)，不需要清零
+    // maxBytes限制这一次最多读多少，没读完的数据留在内核里
+    ssize_t readFd(int fd, int* saveErrno, char* extrabuf, size_t extrabufLen, size_t maxBytes = SIZE_MAX);
+    // 从fd上读取数据, 使用线程局部的溢出区
     ssize_t readFd(int fd, int* saveErrno);
     // 通过fd发送数据
-    ssize_t writeFd(int fd, int* saveErrno);
+    // maxBytes限制一次最多写多少，限速时使用
+    ssize_t writeFd(int fd, int* saveErrno, size_t maxBytes = SIZE_MAX);
 private:
     // 获取首元素的地址,迭代器变成---->指针的写法
     char* begin()
@@ -151,4 +280,11 @@ private:
     std::vector<char> buffer_;
     size_t readerIndex_; // 写下标
     size_t writerIndex_; // 读下标-----> 已经读取的区域就是 writerIndex_ - readerIndex_
+
+    size_t readHint_;   // 根据最近几次readFd的读取量估计的下一次读取量
+    bool lastReadFull_; // 上一次readv把Buffer和溢出区都填满了，说明socket里还有数据
+
+    // 相对readerIndex_的偏移，之前的数据已经扫描过，确定没有对应的分隔符
+    mutable size_t crlfScanned_;
+    mutable size_t eolScanned_;
 };
\ No newline at end of file
@@ -2,17 +2,29 @@
 
 #include <memory>
 #include <functional>
+#include <string>
 
 class Buffer;
 class TcpConnection;
 class Timestamp;
+struct TcpInfo;
 
 // 指向TcpConnection的智能指针
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+// 引用计数的只读发送数据，可以被多个连接、多个线程同时持有
+using PayloadPtr = std::shared_ptr<const std::string>;
 using ConnectionCallback = std::function<void (const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void (const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void (const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void (const TcpConnectionPtr&,
                                         Buffer*,
                                         Timestamp)>;
-using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using TimerCallback = std::function<void()>;
+using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
+// TCP_INFO每次采样以后的回调
+using TcpInfoCallback = std::function<void (const TcpConnectionPtr&, const TcpInfo&)>;
+// 零拷贝接收模式下的消息回调，data是只读视图，回调返回以后视图被释放，需要保留的数据要自己拷贝
+using ZeroCopyMessageCallback = std::function<void (const TcpConnectionPtr&,
+                                        const char*,
+                                        size_t,
+                                        Timestamp)>;
\ No newline at end of file
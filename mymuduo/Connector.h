@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+/**
+ * 主动发起连接，TcpClient使用，对应服务端的Acceptor
+ * 非阻塞connect以后用Channel关注可写事件，可写时用SO_ERROR判断连接是否成功；
+ * 失败以后用定时器重试，重试间隔从500ms开始指数增长，最多30s
+ */ 
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb)
+    { newConnectionCallback_ = cb; }
+
+    void start(); // 可以在任意线程调用
+    void restart(); // 必须在loop线程调用，连接断开以后重新连接，重试间隔回到初始值
+    void stop(); // 可以在任意线程调用
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+    static const int kMaxRetryDelayMs = 30 * 1000;
+    static const int kInitRetryDelayMs = 500;
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    // connect正在进行，等待可写事件
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    // 不再关注sockfd，sockfd交给调用方
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_; // 用户是否希望连接
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_;
+    NewConnectionCallback newConnectionCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
@@ -2,6 +2,7 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -32,8 +33,10 @@ EventLoop::EventLoop()
     , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid())
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , extraBuffer_(new char[kExtraBufferSize]) // 不加()，不会清零
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
     if (t_loopInThisThread)
@@ -120,7 +123,7 @@ void EventLoop::runInLoop(Functor cb)
     }
     else // 在非当前loop线程中执行cb , 就需要唤醒loop所在线程，执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 // 把cb放入队列中，唤醒loop所在的线程，执行cb
@@ -128,7 +131,7 @@ void EventLoop::queueInLoop(Functor cb)
 {
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
+        pendingFunctors_.emplace_back(std::move(cb)); // 移动进队列，不拷贝回调里绑定的数据
     }
 
     // 唤醒相应的，需要执行上面回调操作的loop的线程了
@@ -149,6 +152,24 @@ void EventLoop::handleRead()
   }
 }
 
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    int64_t when = Timestamp::monotonicMicroSeconds()
+        + static_cast<int64_t>(delay * Timestamp::kMicroSecondsPerSecond);
+    return timerQueue_->addTimer(std::move(cb), when, 0);
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    int64_t delta = static_cast<int64_t>(interval * Timestamp::kMicroSecondsPerSecond);
+    return timerQueue_->addTimer(std::move(cb), Timestamp::monotonicMicroSeconds() + delta, delta);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 用来唤醒loop所在的线程的  向wakeupfd_写一个数据，wakeupChannel就发生读事件，当前loop线程就会被唤醒
 void EventLoop::wakeup()
 {
@@ -9,9 +9,12 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 // 时间循环类  主要包含了两个大模块 Channel   Poller（epoll的抽象）
 class EventLoop : noncopyable
@@ -38,6 +41,13 @@ public:
     // 把cb放入队列中，唤醒loop所在的线程，执行cb
     void queueInLoop(Functor cb);
 
+    // 定时器，线程安全，回调在loop线程里执行，时间单位是秒
+    // delay秒以后执行一次cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    void cancel(TimerId timerId);
+
     // 用来唤醒loop所在的线程的
     void wakeup();
 
@@ -49,7 +59,13 @@ public:
     // 判断EventLoop对象是否在自己的线程里面
     // threadId_代表主线程
     bool isInLoopThread() const { return threadId_ ==  CurrentThread::tid(); }
+
+    // 本loop上所有连接共用的读溢出区，Buffer::readFd使用，只分配一次且不清零
+    char* extraBuffer() { return extraBuffer_.get(); }
+    size_t extraBufferSize() const { return kExtraBufferSize; }
 private:
+    static const size_t kExtraBufferSize = 65536;
+
     void handleRead(); // wake up
     void doPendingFunctors(); // 执行回调
 
@@ -62,12 +78,15 @@ private:
 
     Timestamp pollReturnTime_; // poller返回发生事件的channels的时间点
     std::unique_ptr<Poller> poller_; // Eventloop管理的poller
+    std::unique_ptr<TimerQueue> timerQueue_;
 
     // 主要作用，当mainLoop获取一个新用户的channel，
     // 通过轮询算法选择一个subloop（sunreactor），通过该成员唤醒subloop处理channel
     int wakeupFd_; 
     std::unique_ptr<Channel> wakeupChannel_; 
 
+    std::unique_ptr<char[]> extraBuffer_; // 读溢出区 64K
+
     ChannelList activeChannels_; //Eventloop管理的所有channel
 
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
@@ -0,0 +1,47 @@
+#include "LengthHeaderCodec.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#include <sys/uio.h>
+#include <endian.h>
+
+LengthHeaderCodec::LengthHeaderCodec(const FrameCallback &cb, size_t maxFrameLength)
+    : frameCallback_(cb)
+    , maxFrameLength_(maxFrameLength)
+{
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    // 一次可能读到多帧，循环处理完所有完整的帧，剩下不完整的留在Buffer里等下一次
+    while (buf->readableBytes() >= kHeaderLen)
+    {
+        const uint32_t len = static_cast<uint32_t>(buf->peekInt32());
+        if (len > maxFrameLength_)
+        {
+            LOG_ERROR("LengthHeaderCodec::onMessage [%s] invalid length %u \n", conn->name().c_str(), len);
+            buf->retrieveAll();
+            conn->shutdown();
+            break;
+        }
+        if (buf->readableBytes() < kHeaderLen + len)
+        {
+            break; // 这一帧还没收全
+        }
+        buf->retrieve(kHeaderLen);
+        frameCallback_(conn, buf->peek(), len, receiveTime);
+        buf->retrieve(len);
+    }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, const char *data, size_t len)
+{
+    uint32_t be32 = htobe32(static_cast<uint32_t>(len));
+    struct iovec vec[2];
+    vec[0].iov_base = &be32;
+    vec[0].iov_len = sizeof be32;
+    vec[1].iov_base = const_cast<char*>(data);
+    vec[1].iov_len = len;
+    conn->send(vec, 2);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+#include <stdint.h>
+
+/**
+ * 长度头编解码器  每一帧 = 4字节网络字节序的长度 + 消息体
+ * 用法：server.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec, _1, _2, _3))
+ * 一次读到的多帧在一次onMessage里全部处理，消息体以Buffer内部视图的方式交给用户，不拷贝
+ */ 
+class LengthHeaderCodec : noncopyable
+{
+public:
+    // data指向Buffer内部，回调返回以后就失效，需要保留的话自己拷贝
+    using FrameCallback = std::function<void (const TcpConnectionPtr&,
+                                            const char* data,
+                                            size_t len,
+                                            Timestamp)>;
+
+    explicit LengthHeaderCodec(const FrameCallback &cb, size_t maxFrameLength = 64 * 1024 * 1024);
+
+    // 作为TcpServer的MessageCallback使用
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // 加上长度头发送，长度头和消息体通过一次writev发出去
+    void send(const TcpConnectionPtr &conn, const char *data, size_t len);
+    void send(const TcpConnectionPtr &conn, const std::string &message)
+    {
+        send(conn, message.data(), message.size());
+    }
+private:
+    static const size_t kHeaderLen = sizeof(int32_t);
+
+    FrameCallback frameCallback_;
+    const size_t maxFrameLength_; // 超过这个长度认为是非法数据，断开连接
+};
@@ -0,0 +1,55 @@
+#include "LineCodec.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#include <sys/uio.h>
+
+static const char kLineEnd[] = "\r\n";
+
+LineCodec::LineCodec(const LineCallback &cb, Delimiter delimiter, size_t maxLineLength)
+    : lineCallback_(cb)
+    , delimiter_(delimiter)
+    , maxLineLength_(maxLineLength)
+{
+}
+
+void LineCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    const size_t delimLen = delimiter_ == kCRLF ? 2 : 1;
+    // 一次读到的多行在这里全部处理；Buffer会记住扫描位置，不完整的行下次不会从头再扫
+    while (true)
+    {
+        const char *eol = delimiter_ == kCRLF ? buf->findCRLF() : buf->findEOL();
+        if (eol == nullptr)
+        {
+            if (buf->readableBytes() > maxLineLength_)
+            {
+                LOG_ERROR("LineCodec::onMessage [%s] line too long \n", conn->name().c_str());
+                // 丢掉非法数据，避免关闭前再次收到数据时重复解析
+                buf->retrieveAll();
+                conn->shutdown();
+            }
+            break;
+        }
+        size_t len = eol - buf->peek();
+        // kLF同时接受"\r\n"结尾的行，交给用户的数据里不带'\r'
+        if (delimiter_ == kLF && len > 0 && eol[-1] == '\r')
+        {
+            --len;
+        }
+        lineCallback_(conn, buf->peek(), len, receiveTime);
+        buf->retrieveUntil(eol + delimLen);
+    }
+}
+
+void LineCodec::send(const TcpConnectionPtr &conn, const char *data, size_t len)
+{
+    struct iovec vec[2];
+    vec[0].iov_base = const_cast<char*>(data);
+    vec[0].iov_len = len;
+    // kLF只发送kLineEnd里的'\n'
+    vec[1].iov_base = const_cast<char*>(delimiter_ == kCRLF ? kLineEnd : kLineEnd + 1);
+    vec[1].iov_len = delimiter_ == kCRLF ? 2 : 1;
+    conn->send(vec, 2);
+}
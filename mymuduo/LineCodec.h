@@ -0,0 +1,47 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+
+/**
+ * 按行切分的编解码器，适用于RESP、memcached文本协议、HTTP头等
+ * 用法：server.setMessageCallback(std::bind(&LineCodec::onMessage, &codec, _1, _2, _3))
+ * 每一行以Buffer内部视图的方式交给用户（不含行尾分隔符），不拷贝
+ */ 
+class LineCodec : noncopyable
+{
+public:
+    // data指向Buffer内部，回调返回以后就失效，需要保留的话自己拷贝
+    using LineCallback = std::function<void (const TcpConnectionPtr&,
+                                           const char* data,
+                                           size_t len,
+                                           Timestamp)>;
+
+    enum Delimiter
+    {
+        kCRLF, // 行尾是"\r\n"
+        kLF,   // 行尾是'\n'，前面如果有'\r'也一并去掉
+    };
+
+    explicit LineCodec(const LineCallback &cb,
+                       Delimiter delimiter = kCRLF,
+                       size_t maxLineLength = 64 * 1024);
+
+    // 作为TcpServer的MessageCallback使用
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // 加上行尾分隔符发送，和数据通过一次writev发出去
+    void send(const TcpConnectionPtr &conn, const char *data, size_t len);
+    void send(const TcpConnectionPtr &conn, const std::string &line)
+    {
+        send(conn, line.data(), line.size());
+    }
+private:
+    LineCallback lineCallback_;
+    const Delimiter delimiter_;
+    const size_t maxLineLength_; // 一直找不到行尾且超过这个长度，认为是非法数据，断开连接
+};
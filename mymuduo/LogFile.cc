@@ -0,0 +1,206 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+LogFile::LogFile(const std::string &basename,
+                 off_t rollSize,
+                 int rollInterval,
+                 int fsyncInterval,
+                 size_t bufferSize)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , rollInterval_(rollInterval)
+    , fsyncInterval_(fsyncInterval)
+    , fd_(-1)
+    , writtenBytes_(0)
+    , nextRollTime_(0)
+    , lastRoll_(0)
+    , lastFsync_(0)
+    , lastOpenFailure_(0)
+    , buffer_(new char[bufferSize])
+    , bufferSize_(bufferSize)
+    , bufferLen_(0)
+    , droppedLines_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    writeBuffer();
+    if (fd_ >= 0)
+    {
+        ::fdatasync(fd_);
+        ::close(fd_);
+    }
+}
+
+void LogFile::append(const char *logline, size_t len)
+{
+    time_t now = ::time(nullptr);
+    if (writtenBytes_ + static_cast<off_t>(bufferLen_ + len) > rollSize_
+        || now >= nextRollTime_)
+    {
+        rollFile();
+    }
+    if (fd_ < 0)
+    {
+        // 文件还没打开，直接丢弃，不往缓冲区里攒
+        dropLines(logline, len);
+        return;
+    }
+
+    if (bufferLen_ + len > bufferSize_)
+    {
+        writeBuffer();
+    }
+    if (len >= bufferSize_)
+    {
+        // 比整个缓冲区还大（AsyncLogging一次交过来4M），直接写，不再拷贝
+        size_t written = 0;
+        while (fd_ >= 0 && written < len)
+        {
+            ssize_t n = ::write(fd_, logline + written, len - written);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                fprintf(stderr, "LogFile::append write error:%d\n", errno);
+                dropLines(logline + written, len - written);
+                break;
+            }
+            written += n;
+        }
+        writtenBytes_ += written;
+        return;
+    }
+    ::memcpy(buffer_.get() + bufferLen_, logline, len);
+    bufferLen_ += len;
+}
+
+void LogFile::flush()
+{
+    writeBuffer();
+    time_t now = ::time(nullptr);
+    if (fd_ >= 0 && now - lastFsync_ >= fsyncInterval_)
+    {
+        lastFsync_ = now;
+        ::fdatasync(fd_);
+    }
+}
+
+void LogFile::writeBuffer()
+{
+    size_t written = 0;
+    while (fd_ >= 0 && written < bufferLen_)
+    {
+        ssize_t n = ::write(fd_, buffer_.get() + written, bufferLen_ - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "LogFile::writeBuffer write error:%d\n", errno);
+            break;
+        }
+        written += n;
+    }
+    if (written < bufferLen_)
+    {
+        dropLines(buffer_.get() + written, bufferLen_ - written);
+    }
+    writtenBytes_ += written;
+    bufferLen_ = 0;
+}
+
+void LogFile::dropLines(const char *data, size_t len)
+{
+    // 只在出错的时候走到这里，数一下换行符就够了
+    droppedLines_ += std::count(data, data + len, '\n');
+}
+
+bool LogFile::rollFile()
+{
+    time_t now = ::time(nullptr);
+    // 文件名精确到秒，同一秒内不重复滚动，避免覆盖
+    if (now == lastRoll_ && fd_ >= 0)
+    {
+        return false;
+    }
+    // 打开失败以后每次append都会走到这里，一秒最多重试一次，不让日志路径变成open和stderr的系统调用风暴
+    if (now == lastOpenFailure_)
+    {
+        return false;
+    }
+
+    std::string filename = getLogFileName(basename_, now);
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        lastOpenFailure_ = now;
+        fprintf(stderr, "LogFile::rollFile open %s error:%d, dropped lines:%zu\n",
+                filename.c_str(), errno, droppedLines_);
+        return false;
+    }
+
+    // 旧文件的缓冲区写完、落盘以后再换
+    writeBuffer();
+    if (fd_ >= 0)
+    {
+        ::fdatasync(fd_);
+        ::close(fd_);
+    }
+    fd_ = fd;
+    writtenBytes_ = 0;
+    lastRoll_ = now;
+    lastFsync_ = now;
+    nextRollTime_ = startOfPeriod(now, rollInterval_) + rollInterval_;
+    return true;
+}
+
+time_t LogFile::startOfPeriod(time_t now, int rollInterval)
+{
+    // 文件名用的是本地时间，周期也要按本地时间对齐，否则每天滚动的时刻偏离本地0点，一个文件跨两个日期
+    struct tm tm_time;
+    ::localtime_r(&now, &tm_time);
+    time_t local = now + tm_time.tm_gmtoff;
+    return local / rollInterval * rollInterval - tm_time.tm_gmtoff;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t now)
+{
+    std::string filename;
+    filename.reserve(basename.size() + 64);
+    filename = basename;
+
+    char timebuf[32];
+    struct tm tm_time;
+    ::localtime_r(&now, &tm_time);
+    strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm_time);
+    filename += timebuf;
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof hostname) == 0)
+    {
+        hostname[sizeof hostname - 1] = '\0';
+        filename += hostname;
+    }
+    else
+    {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+#include <time.h>
+#include <sys/types.h>
+
+/**
+ * 滚动日志文件，作为AsyncLogging的输出端，只在AsyncLogging的后台线程里使用，不加锁
+ * 写入先进用户态的大缓冲区，满了才write一次；文件超过rollSize或者跨过rollInterval周期时换新文件；
+ * flush把缓冲区写进内核，距离上次fdatasync超过fsyncInterval秒才落盘一次
+ * 
+ * 用法：
+ *   LogFile file("/var/log/server", 512 * 1024 * 1024);
+ *   AsyncLogging async;
+ *   async.setOutput(std::bind(&LogFile::append, &file, _1, _2));
+ *   async.setFlush(std::bind(&LogFile::flush, &file));
+ *   async.start();
+ */ 
+class LogFile : noncopyable
+{
+public:
+    // 文件名：basename.20261018-170809.hostname.pid.log
+    LogFile(const std::string &basename,
+            off_t rollSize,
+            int rollInterval = 24 * 60 * 60,
+            int fsyncInterval = 3,
+            size_t bufferSize = 1024 * 1024);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    // 立刻换一个新文件，返回是否成功；打开失败以后同一秒内不再重试
+    bool rollFile();
+    // 因为文件打不开或者写失败而丢掉的日志行数
+    size_t droppedLines() const { return droppedLines_; }
+private:
+    // 缓冲区写进内核
+    void writeBuffer();
+    void dropLines(const char *data, size_t len);
+    static std::string getLogFileName(const std::string &basename, time_t now);
+    // now所在的滚动周期按本地时间对齐的开始时间
+    static time_t startOfPeriod(time_t now, int rollInterval);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int rollInterval_; // 秒，按本地时间这个周期的整数倍滚动，默认每天本地0点，和文件名里的日期一致
+    const int fsyncInterval_;
+
+    int fd_;
+    off_t writtenBytes_; // 当前文件已经写了多少
+    time_t nextRollTime_; // 下一个滚动周期开始的时间
+    time_t lastRoll_;
+    time_t lastFsync_;
+    time_t lastOpenFailure_; // 上一次打开文件失败的时间
+
+    std::unique_ptr<char[]> buffer_;
+    const size_t bufferSize_;
+    size_t bufferLen_;
+    size_t droppedLines_;
+};
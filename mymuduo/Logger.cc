@@ -1,7 +1,31 @@
 #include "Logger.h"
 #include "Timestamp.h"
 
-#include <iostream>
+#include <stdio.h>
+
+namespace
+{
+
+// 整行一次fwrite，stdio内部有锁，多个线程的日志不会交错
+void defaultOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, stdout);
+    ::fflush(stdout);
+}
+
+void defaultFlush()
+{
+    ::fflush(stdout);
+}
+
+} // namespace
+
+Logger::Logger()
+    : logLevel_(MYMUDUO_LOG_FLOOR) // 编译进来的级别默认都输出，定义MUDEBUG时和原来一样打印DEBUG
+    , output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
 
 // 获取日志唯一的实例对象
 Logger& Logger::instance()
@@ -10,33 +34,49 @@ Logger& Logger::instance()
     return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level)
-{
-    logLevel_ = level;
-}
-
 // 写日志  [级别信息] time : msg
-void Logger::log(std::string msg)
+void Logger::log(int level, const char *msg)
 {
-    switch (logLevel_)
+    const char *levelName = "";
+    switch (level)
     {
+    case TRACE:
+        levelName = "[TRACE]";
+        break;
+    case DEBUG:
+        levelName = "[DEBUG]";
+        break;
     case INFO:
-        std::cout << "[INFO]";
+        levelName = "[INFO]";
         break;
     case ERROR:
-        std::cout << "[ERROR]";
+        levelName = "[ERROR]";
         break;
     case FATAL:
-        std::cout << "[FATAL]";
-        break;
-    case DEBUG:
-        std::cout << "[DEBUG]";
+        levelName = "[FATAL]";
         break;
     default:
         break;
     }
 
-    // 打印当前时间和错误msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    // 先在栈上拼好一整行再交给output_，不同线程的日志不会互相穿插
+    char timebuf[32];
+    Timestamp::now().formatTo(timebuf, sizeof timebuf);
+    char line[1280];
+    int len = snprintf(line, sizeof line, "%s%s : %s\n", levelName, timebuf, msg);
+    if (len < 0)
+    {
+        return;
+    }
+    if (static_cast<size_t>(len) >= sizeof line)
+    {
+        len = sizeof line - 1;
+        line[len - 1] = '\n';
+    }
+    output_(line, len);
+
+    if (level == FATAL)
+    {
+        flush_();
+    }
+}
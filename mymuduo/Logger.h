@@ -1,64 +1,87 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "noncopyable.h"
 
+// 日志级别按严重程度从低到高排列，预处理器里也要用到，所以同时定义成宏
+#define MYMUDUO_LOG_TRACE 0
+#define MYMUDUO_LOG_DEBUG 1
+#define MYMUDUO_LOG_INFO  2
+#define MYMUDUO_LOG_ERROR 3
+#define MYMUDUO_LOG_FATAL 4
+
+// 编译期的级别下限，低于它的LOG_XXX展开成空语句，参数都不会求值
+// 默认编译掉TRACE和DEBUG，定义MUDEBUG时保留DEBUG，也可以用-DMYMUDUO_LOG_FLOOR=0全部保留
+#ifndef MYMUDUO_LOG_FLOOR
+#ifdef MUDEBUG
+#define MYMUDUO_LOG_FLOOR MYMUDUO_LOG_DEBUG
+#else
+#define MYMUDUO_LOG_FLOOR MYMUDUO_LOG_INFO
+#endif
+#endif
+
 // LOG_INFO("%s %d", arg1, arg2)
 // ...代表可变参数的
 // ##__VA_ARGS__ 获取可参的宏
-#define LOG_INFO(logmsgFormat, ...) \
+// 先比较运行期的级别阈值，低于阈值时不做任何格式化
+#define MYMUDUO_LOG(level, logmsgFormat, ...) \
     do \
     { \
         Logger &logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+        if (logger.logLevel() <= level) \
+        { \
+            char buf[1024]; \
+            snprintf(buf, sizeof buf, logmsgFormat, ##__VA_ARGS__); \
+            logger.log(level, buf); \
+        } \
+    } while(0)
 
-#define LOG_ERROR(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+#define MYMUDUO_LOG_NOTHING() do {} while(0)
+
+#if MYMUDUO_LOG_FLOOR <= MYMUDUO_LOG_TRACE
+#define LOG_TRACE(logmsgFormat, ...) MYMUDUO_LOG(TRACE, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(logmsgFormat, ...) MYMUDUO_LOG_NOTHING()
+#endif
+
+#if MYMUDUO_LOG_FLOOR <= MYMUDUO_LOG_DEBUG
+#define LOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG_NOTHING()
+#endif
 
+#if MYMUDUO_LOG_FLOOR <= MYMUDUO_LOG_INFO
+#define LOG_INFO(logmsgFormat, ...) MYMUDUO_LOG(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) MYMUDUO_LOG_NOTHING()
+#endif
+
+// ERROR和FATAL不受编译期下限影响
+#define LOG_ERROR(logmsgFormat, ...) MYMUDUO_LOG(ERROR, logmsgFormat, ##__VA_ARGS__)
+
+// FATAL不受运行期阈值影响，一定会输出，然后退出程序
 #define LOG_FATAL(logmsgFormat, ...) \
     do \
     { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        char buf[1024]; \
+        snprintf(buf, sizeof buf, logmsgFormat, ##__VA_ARGS__); \
+        Logger::instance().log(FATAL, buf); \
         exit(-1); \
-    } while(0) 
+    } while(0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
-#else
-    #define LOG_DEBUG(logmsgFormat, ...)
-#endif
-
-// 定义日志的级别  INFO  ERROR  FATAL  DEBUG 
+// 定义日志的级别  TRACE  DEBUG  INFO  ERROR  FATAL
 enum LogLevel
 {
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core信息  系统无法继续向下运行，无法挽回的错误
-    DEBUG, // 调试信息   
+    TRACE = MYMUDUO_LOG_TRACE, // 每个事件的跟踪信息，默认编译掉
+    DEBUG = MYMUDUO_LOG_DEBUG, // 调试信息
+    INFO = MYMUDUO_LOG_INFO,  // 普通信息
+    ERROR = MYMUDUO_LOG_ERROR, // 错误信息
+    FATAL = MYMUDUO_LOG_FATAL, // core信息  系统无法继续向下运行，无法挽回的错误
 };
 
 // 输出一个日志类
@@ -66,12 +89,26 @@ enum LogLevel
 class Logger : noncopyable
 {
 public:
+    // 日志输出的目的地，收到的是格式化好的一整行（包括换行符）
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
     // 获取日志唯一的实例对象
     static Logger& instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+    // 设置运行期的日志级别阈值，低于它的日志直接跳过，默认INFO
+    void setLogLevel(int level) { logLevel_.store(level, std::memory_order_relaxed); }
+    int logLevel() const { return logLevel_.load(std::memory_order_relaxed); }
+    // 写日志，msg是已经格式化好的内容
+    void log(int level, const char *msg);
+
+    // 默认一行一次fwrite到stdout，可以换成AsyncLogging::append，在程序开始打日志之前设置
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+    // FATAL日志退出程序之前调用，保证日志落地
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
 private:
-    int logLevel_;
+    Logger();
+
+    std::atomic_int logLevel_;
+    OutputFunc output_;
+    FlushFunc flush_;
 };
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include "Socket.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "SocketOptions.h"
 
 #include <unistd.h>
 #include <sys/types.h>         
 #include <sys/socket.h>
+#include <errno.h>
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
@@ -27,9 +29,9 @@ void Socket::bindAddress(const InetAddress &localaddr)
     }
 }
 
-void Socket::listen()
+void Socket::listen(int backlog)
 {
-    if (0 != ::listen(sockfd_, 1024))
+    if (0 != ::listen(sockfd_, backlog))
     {
         LOG_FATAL("listen sockfd:%d fail \n", sockfd_);
     }
@@ -84,4 +86,145 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) == 0;
+}
+
+namespace
+{
+
+void setOption(int sockfd, int level, int name, int value, const char *optName)
+{
+    if (::setsockopt(sockfd, level, name, &value, sizeof value) < 0)
+    {
+        LOG_ERROR("setsockopt %s=%d sockfd:%d err:%d \n", optName, value, sockfd, errno);
+    }
+}
+
+} // namespace
+
+bool Socket::getTcpInfo(struct tcp_info *info) const
+{
+    socklen_t len = sizeof(*info);
+    ::bzero(info, len);
+    return ::getsockopt(sockfd_, IPPROTO_TCP, TCP_INFO, info, &len) == 0;
+}
+
+int Socket::getSendBufferSize() const
+{
+    int optval = 0;
+    socklen_t len = sizeof optval;
+    if (::getsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &optval, &len) < 0)
+    {
+        return -1;
+    }
+    return optval;
+}
+
+void Socket::setSendBufferSize(int bytes)
+{
+    setOption(sockfd_, SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+}
+
+void Socket::setRecvBufferSize(int bytes)
+{
+    setOption(sockfd_, SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+}
+
+void Socket::setTcpQuickAck(bool on)
+{
+    setOption(sockfd_, IPPROTO_TCP, TCP_QUICKACK, on ? 1 : 0, "TCP_QUICKACK");
+}
+
+void Socket::setTcpCork(bool on)
+{
+    setOption(sockfd_, IPPROTO_TCP, TCP_CORK, on ? 1 : 0, "TCP_CORK");
+}
+
+void Socket::setTcpNotSentLowat(int bytes)
+{
+    setOption(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes, "TCP_NOTSENT_LOWAT");
+}
+
+void Socket::setTcpDeferAccept(int seconds)
+{
+    setOption(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds, "TCP_DEFER_ACCEPT");
+}
+
+void Socket::setTcpFastOpen(int queueLen)
+{
+    setOption(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, queueLen, "TCP_FASTOPEN");
+}
+
+void Socket::setKeepAliveParams(int idleSeconds, int intervalSeconds, int count)
+{
+    if (idleSeconds > 0)
+    {
+        setOption(sockfd_, IPPROTO_TCP, TCP_KEEPIDLE, idleSeconds, "TCP_KEEPIDLE");
+    }
+    if (intervalSeconds > 0)
+    {
+        setOption(sockfd_, IPPROTO_TCP, TCP_KEEPINTVL, intervalSeconds, "TCP_KEEPINTVL");
+    }
+    if (count > 0)
+    {
+        setOption(sockfd_, IPPROTO_TCP, TCP_KEEPCNT, count, "TCP_KEEPCNT");
+    }
+}
+
+void Socket::applyListenOptions(const SocketOptions &opts)
+{
+    if (opts.deferAcceptSeconds > 0)
+    {
+        setTcpDeferAccept(opts.deferAcceptSeconds);
+    }
+    if (opts.fastOpenQueue > 0)
+    {
+        setTcpFastOpen(opts.fastOpenQueue);
+    }
+    // 缓冲区大小会被accept出来的连接继承
+    if (opts.sendBufferSize > 0)
+    {
+        setSendBufferSize(opts.sendBufferSize);
+    }
+    if (opts.recvBufferSize > 0)
+    {
+        setRecvBufferSize(opts.recvBufferSize);
+    }
+}
+
+void Socket::applyOptions(const SocketOptions &opts)
+{
+    if (opts.tcpNoDelay)
+    {
+        setTcpNoDelay(true);
+    }
+    if (opts.tcpQuickAck)
+    {
+        setTcpQuickAck(true);
+    }
+    if (opts.sendBufferSize > 0)
+    {
+        setSendBufferSize(opts.sendBufferSize);
+    }
+    if (opts.recvBufferSize > 0)
+    {
+        setRecvBufferSize(opts.recvBufferSize);
+    }
+    if (opts.notSentLowat > 0)
+    {
+        setTcpNotSentLowat(opts.notSentLowat);
+    }
+    if (opts.keepAlive) // TcpConnection构造时已经打开了SO_KEEPALIVE
+    {
+        setKeepAliveParams(opts.keepIdleSeconds, opts.keepIntervalSeconds, opts.keepCount);
+    }
+    else
+    {
+        setKeepAlive(false);
+    }
+}
@@ -3,6 +3,8 @@
 #include "noncopyable.h"
 
 class InetAddress; // 前置声明
+struct SocketOptions;
+struct tcp_info;
 
 // 封装socket fd
 class Socket : noncopyable
@@ -20,7 +22,7 @@ public:
     */
     int fd() const { return sockfd_; } // 只读
     void bindAddress(const InetAddress &localaddr); // 绑定IP+PORT
-    void listen(); // 监听端口是否有连接
+    void listen(int backlog = 1024); // 监听端口是否有连接
     int accept(InetAddress *peeraddr); // 完成连接
 
     void shutdownWrite();
@@ -36,6 +38,30 @@ public:
 
     // 设置 SO_KEEPALIVE 选项
     void setKeepAlive(bool on);
+
+    // 读取TCP_INFO，失败时返回false
+    bool getTcpInfo(struct tcp_info *info) const;
+    // 当前的SO_SNDBUF，失败时返回-1
+    int getSendBufferSize() const;
+
+    // 设置 SO_ZEROCOPY 选项，之后才能用MSG_ZEROCOPY发送，内核不支持时返回false
+    bool setZeroCopy(bool on);
+
+    // 下面的调优选项含义见SocketOptions，设置失败时打印错误日志
+    void setSendBufferSize(int bytes);
+    void setRecvBufferSize(int bytes);
+    void setTcpQuickAck(bool on);
+    // 打开以后不满一个MSS的数据先攒着，关闭时一起发出去，最多攒200ms
+    void setTcpCork(bool on);
+    void setTcpNotSentLowat(int bytes);
+    void setTcpDeferAccept(int seconds);
+    void setTcpFastOpen(int queueLen);
+    void setKeepAliveParams(int idleSeconds, int intervalSeconds, int count);
+
+    // 设置监听socket的选项，在listen之前调用
+    void applyListenOptions(const SocketOptions &opts);
+    // 设置连接socket的选项
+    void applyOptions(const SocketOptions &opts);
 private:
     const int sockfd_;
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * socket调优选项，TcpServer::setSocketOptions设置以后
+ * 监听相关的选项由Acceptor在listen时设置，连接相关的选项在每个新连接上设置
+ * 0/false表示不设置，保持内核默认值
+ */ 
+struct SocketOptions
+{
+    SocketOptions()
+        : listenBacklog(1024)
+        , deferAcceptSeconds(0)
+        , fastOpenQueue(0)
+        , tcpNoDelay(false)
+        , tcpQuickAck(false)
+        , sendBufferSize(0)
+        , recvBufferSize(0)
+        , notSentLowat(0)
+        , keepAlive(true)
+        , keepIdleSeconds(0)
+        , keepIntervalSeconds(0)
+        , keepCount(0)
+    {}
+
+    // 监听socket
+    int listenBacklog;      // 实际上限还受net.core.somaxconn限制
+    int deferAcceptSeconds; // TCP_DEFER_ACCEPT，握手以后等客户端发来数据才唤醒accept，最多等这么多秒
+    int fastOpenQueue;      // TCP_FASTOPEN，还没完成accept的TFO请求最多排队多少个
+
+    // 连接socket
+    bool tcpNoDelay;        // 关闭Nagle算法，小包立即发送
+    bool tcpQuickAck;       // 内核会自动退回延迟确认，所以每次读完都要重新设置，多一次系统调用
+    int sendBufferSize;     // SO_SNDBUF，设置以后内核不再自动调整
+    int recvBufferSize;     // SO_RCVBUF，同时设置在监听socket上，握手时才能协商到合适的窗口扩大因子
+    int notSentLowat;       // TCP_NOTSENT_LOWAT，内核里还没发出去的数据少于这么多字节才报告可写
+    bool keepAlive;
+    int keepIdleSeconds;    // TCP_KEEPIDLE
+    int keepIntervalSeconds;// TCP_KEEPINTVL
+    int keepCount;          // TCP_KEEPCNT
+};
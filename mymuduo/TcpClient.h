@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * 用户使用muduo编写客户端程序，比如代理服务器连接后端
+ */ 
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TcpConnection.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+class Connector;
+class EventLoop;
+using ConnectorPtr = std::shared_ptr<Connector>;
+
+// 对外的客户端编程使用的类，一个TcpClient同时最多有一条连接
+// 连接建立在构造时传入的loop上，可以是TcpServer的某个subloop，这样代理的两条连接在同一个线程里
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg);
+    ~TcpClient(); // 必须在loop线程里析构
+
+    void connect();
+    // 关闭已经建立的连接（半关闭写端）
+    void disconnect();
+    // 停止正在进行的连接和重试
+    void stop();
+
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    // 已经建立的连接断开以后自动重连
+    void enableRetry() { retry_ = true; }
+
+    const std::string& name() const { return name_; }
+
+    // 需要在connect之前设置，不是线程安全的
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+private:
+    // 在loop线程里调用
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    const TcpConnection::NamePrefixPtr namePrefix_; // "name:ip:port"
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    uint64_t nextConnId_; // 只在loop线程里访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 由mutex_保护
+};
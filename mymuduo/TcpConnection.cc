@@ -3,6 +3,8 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "TokenBucket.h"
+#include "SocketOptions.h"
 
 #include <functional>
 #include <errno.h>
@@ -11,7 +13,20 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <limits.h>
+#include <algorithm>
 #include <string>
+#include <inttypes.h>
+#include <string.h>
+#include <linux/falloc.h>
+#include <time.h>
 
 /*
     由于Buffer缓冲区的存在,读取数据时，只需要将套接字的数据读到
@@ -20,6 +35,15 @@
 */
 
 
+// 溢出文件每发出去这么多就打洞释放一次
+static const off_t kSpillReleaseBytes = 1024 * 1024;
+
+// 限速暂停以后至少攒够这么多令牌再恢复，避免每次只发几个字节
+static const size_t kThrottleResumeBytes = 16 * 1024;
+// 连接销毁以后最多等零拷贝完成通知这么久，每隔kZeroCopyLingerPollInterval秒读一次错误队列
+static const int64_t kZeroCopyLingerSeconds = 10;
+static const double kZeroCopyLingerPollInterval = 0.01;
+
 // 检查事件是否为空,如果为空则记录日志并返回
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -30,20 +54,113 @@ static EventLoop* CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
+using ZeroCopyPending = std::deque<std::pair<uint32_t, PayloadPtr>>;
+
+// 读取fd错误队列里的零拷贝完成通知，从pending里删掉内核已经用完的payload，返回处理的通知个数
+static int drainZeroCopyCompletions(int fd, ZeroCopyPending &pending)
+{
+    int notifications = 0;
+    char control[128];
+    // 不管还有没有在途的发送都要把错误队列读空，否则LT模式下EPOLLERR会一直触发
+    for (;;)
+    {
+        struct msghdr msg;
+        bzero(&msg, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            break; // EAGAIN，错误队列已经读空了
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+            {
+                continue;
+            }
+            const struct sock_extended_err *serr =
+                reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            ++notifications;
+            const uint32_t lo = serr->ee_info;
+            const uint32_t hi = serr->ee_data;
+            // 序号会回绕，用无符号减法判断是否落在[lo, hi]区间
+            pending.erase(
+                std::remove_if(pending.begin(), pending.end(),
+                    [lo, hi](const std::pair<uint32_t, PayloadPtr> &item) {
+                        return item.first - lo <= hi - lo;
+                    }),
+                pending.end());
+        }
+    }
+    return notifications;
+}
+
+// 连接销毁以后还没等到完成通知的payload
+struct ZeroCopyLinger
+{
+    ZeroCopyLinger(int f, int64_t d) : fd(f), deadline(d) {}
+    ~ZeroCopyLinger() { ::close(fd); }
+
+    int fd;
+    int64_t deadline; // 单调时钟微秒，超时以后不再等
+    ZeroCopyPending pending;
+};
+
+static void pollZeroCopyLinger(EventLoop *loop, const std::shared_ptr<ZeroCopyLinger> &linger)
+{
+    drainZeroCopyCompletions(linger->fd, linger->pending);
+    if (linger->pending.empty())
+    {
+        return;
+    }
+    if (Timestamp::monotonicMicroSeconds() >= linger->deadline)
+    {
+        LOG_ERROR("TcpConnection zero-copy completions timed out, %zu payloads released \n", linger->pending.size());
+        return;
+    }
+    loop->runAfter(kZeroCopyLingerPollInterval, std::bind(&pollZeroCopyLinger, loop, linger));
+}
+
 TcpConnection::TcpConnection(EventLoop *loop, 
-                const std::string &nameArg, 
+                uint64_t id,
+                const NamePrefixPtr &namePrefix, 
                 int sockfd,
                 const InetAddress& localAddr,
                 const InetAddress& peerAddr)
     : loop_(CheckLoopNotNull(loop))
-    , name_(nameArg)
+    , id_(id)
+    , namePrefix_(namePrefix)
     , state_(kConnecting)
     , reading_(true)
+    , readPaused_(false)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64*1024*1024) // 64M
+    , userHighWaterMark_(highWaterMark_)
+    , backpressureHigh_(0)
+    , backpressureLow_(0)
+    , throttling_(false)
+    , readBudget_(SIZE_MAX)
+    , quickAck_(false)
+    , tcpInfoSampling_(false)
+    , adaptiveSndBufMin_(0)
+    , adaptiveSndBufMax_(0)
+    , sndBufTarget_(0)
+    , spillThreshold_(0)
+    , spillRetryAt_(0)
+    , zeroCopyThreshold_(0)
+    , zeroCopySeq_(0)
+    , throttled_(false)
+    , zeroCopyRecvAddr_(nullptr)
+    , zeroCopyRecvSize_(0)
 {
     // 下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
     channel_->setReadCallback(
@@ -59,16 +176,44 @@ TcpConnection::TcpConnection(EventLoop *loop,
         std::bind(&TcpConnection::handleError, this)
     );
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
+    LOG_DEBUG("TcpConnection::ctor[#%" PRIu64 "] at fd=%d\n", id_, sockfd);
     socket_->setKeepAlive(true); // 启动保活机制
 }
 
 
+// splice转发用的管道，源连接的数据先splice进管道，再从管道splice到本连接的socket
+struct TcpConnection::SplicePipe
+{
+    SplicePipe() : readFd(-1), writeFd(-1), pending(0) {}
+    ~SplicePipe()
+    {
+        if (readFd >= 0) ::close(readFd);
+        if (writeFd >= 0) ::close(writeFd);
+    }
+
+    int readFd;
+    int writeFd;
+    size_t pending; // 管道里还没发出去的字节数
+    std::weak_ptr<TcpConnection> source;
+};
+
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", 
-        name_.c_str(), channel_->fd(), (int)state_);
+    for (const OutputSegment &seg : outputQueue_)
+    {
+        if (seg.spill)
+        {
+            ::close(seg.fd);
+        }
+    }
+    if (zeroCopyRecvAddr_ != nullptr)
+    {
+        ::munmap(zeroCopyRecvAddr_, zeroCopyRecvSize_);
+    }
+    LOG_DEBUG("TcpConnection::dtor[#%" PRIu64 "] at fd=%d state=%d \n", 
+        id_, channel_->fd(), (int)state_);
 }
+
 // 发送数据接口
 void TcpConnection::send(const std::string &buf)
 {
@@ -76,26 +221,149 @@ void TcpConnection::send(const std::string &buf)
     {
         if (loop_->isInLoopThread())
         {
-            sendInLoop(buf.c_str(), buf.size());
+            sendInLoop(buf.data(), buf.size());
+        }
+        else
+        {
+            // 调用方的buf在send返回后可能就析构了，这里必须拷贝一份交给loop线程
+            void (TcpConnection::*fp)(const std::string &message) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), buf));
+        }
+    }
+}
+
+void TcpConnection::send(std::string &&buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf.data(), buf.size());
+        }
+        else
+        {
+            // string直接移动进任务对象，不拷贝数据
+            void (TcpConnection::*fp)(const std::string &message) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), std::move(buf)));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer &&buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf);
+        }
+        else
+        {
+            void (TcpConnection::*fp)(Buffer &buf) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), std::move(buf)));
+        }
+    }
+}
+
+void TcpConnection::send(const PayloadPtr &payload)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            // 在loop线程里也要走payload版本，大块数据才能用上零拷贝
+            sendInLoop(payload);
+        }
+        else
+        {
+            void (TcpConnection::*fp)(const PayloadPtr &payload) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), payload));
+        }
+    }
+}
+
+// 发送文件接口
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (state_ == kConnected)
+    {
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendFileInLoop, shared_from_this(), fd, offset, length));
+    }
+}
+
+// 聚集发送接口
+void TcpConnection::send(const struct iovec *iov, int iovcnt)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(iov, iovcnt);
         }
         else
         {
-            loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
-            ));
+            // iov指向的内存属于调用方，跨线程时只能先拷贝成一个string再交给loop线程
+            std::string message;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                message.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+            }
+            void (TcpConnection::*fp)(const std::string &message) = &TcpConnection::sendInLoop;
+            loop_->runInLoop(std::bind(fp, shared_from_this(), std::move(message)));
         }
     }
 }
 
+void TcpConnection::sendInLoop(const void* data, size_t len)
+{
+    struct iovec vec;
+    vec.iov_base = const_cast<void*>(data);
+    vec.iov_len = len;
+    sendInLoop(&vec, 1);
+}
+
+void TcpConnection::sendInLoop(const std::string &message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::sendInLoop(Buffer &buf)
+{
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(buf.peek());
+    vec.iov_len = buf.readableBytes();
+    sendInLoop(&vec, 1, &buf);
+}
+
+void TcpConnection::sendInLoop(const PayloadPtr &payload)
+{
+    if (zeroCopyThreshold_ == 0 || payload->size() < zeroCopyThreshold_)
+    {
+        sendInLoop(payload->data(), payload->size());
+        return;
+    }
+
+    // 大块数据走零拷贝，payload作为一个输出段排队，和outputBuffer_、文件段保持顺序
+    OutputSegment seg;
+    seg.remaining = payload->size();
+    seg.payload = payload;
+    sendSegmentInLoop(seg);
+}
+
 /**
  * 发送数据  应用写的快， 而内核发送数据慢， 
  * 需要把待发送数据写入缓冲区， 而且设置了水位回调
+ * 多段数据用一次writev发送，没发完的部分才拷贝进outputBuffer_
  */ 
-void TcpConnection::sendInLoop(const void* data, size_t len)
+void TcpConnection::sendInLoop(const struct iovec *iov, int iovcnt, Buffer *spare)
 {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        len += iov[i].iov_len;
+    }
+
     ssize_t nwrote = 0;
     size_t remaining = len; // 暂未发送的数据
     bool faultError = false;
@@ -109,10 +377,11 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     }
 
     // 表示channel_第一次开始写数据，而且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // 限速的连接不直接写，统一交给handleWrite按令牌发送
+    if (outputIdle() && !rateLimited())
     {
-        // 尝试直接写入数据到socket
-        nwrote = ::write(channel_->fd(), data, len); //发送数据
+        // 尝试直接写入数据到socket，writev一次最多接受IOV_MAX段，多出来的走缓冲区
+        nwrote = ::writev(channel_->fd(), iov, std::min(iovcnt, IOV_MAX)); //发送数据
         if (nwrote >= 0)
         {
             remaining = len - nwrote; // 计算未发送的数据量
@@ -146,124 +415,1039 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     if (!faultError && remaining > 0) 
     {
         // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_
-            && highWaterMarkCallback_)
-        {
-            // 如果缓冲区数据超过高水位标记且设置了高水位回调，则执行高水位回调
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen+remaining)
-            );
-        }
-        // 将剩余的数据追加到缓冲区中
-        outputBuffer_.append((char*)data + nwrote, remaining);
-        // 如果channel没有注册写事件，则注册写事件
-        if (!channel_->isWriting())
+        size_t oldLen = pendingOutputBytes();
+        checkHighWaterMark(oldLen, oldLen + remaining);
+        Buffer *tail = outputTail();
+        if (spare != nullptr && tail->readableBytes() == 0 && !spilling()
+            && (spillThreshold_ == 0 || bufferedOutputBytes() + remaining <= spillThreshold_))
+        {
+            // 数据本来就在一个交给我们的Buffer里，直接换进来，剩余部分不用再拷贝
+            spare->retrieve(nwrote);
+            tail->swap(*spare);
+        }
+        else
+        {
+            // 跳过已经发送的nwrote字节，把每一段剩余的数据追加到缓冲区中
+            size_t skip = nwrote;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                if (skip >= iov[i].iov_len)
+                {
+                    skip -= iov[i].iov_len;
+                    continue;
+                }
+                queueOutput(static_cast<const char*>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+                skip = 0;
+            }
+        }
+        // 如果channel没有注册写事件，则注册写事件；被限速暂停时由resumeWriting注册
+        if (!channel_->isWriting() && !throttled_)
         {
             channel_->enableWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
         }
+        updateBackpressure();
     }
 }
 
-// 关闭连接
-void TcpConnection::shutdown()
+void TcpConnection::spliceTo(const TcpConnectionPtr &peer)
 {
-    if (state_ == kConnected)  //检查连接状态是否为已连接
+    loop_->runInLoop(std::bind(&TcpConnection::spliceToInLoop, shared_from_this(), peer));
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+    OutputSegment seg;
+    seg.fd = fd;
+    seg.offset = offset;
+    seg.remaining = length;
+    sendSegmentInLoop(seg);
+}
+
+void TcpConnection::sendSegmentInLoop(OutputSegment &seg)
+{
+    if (state_ == kDisconnected)
     {
-        setState(kDisconnecting); // 设置连接状态为正在断开连接
-        loop_->runInLoop(
-            std::bind(&TcpConnection::shutdownInLoop, this)
-        );
+        LOG_ERROR("disconnected, give up writing!");
+        return;
     }
+
+    // 前面没有排队的数据，直接发送
+    if (outputIdle() && !rateLimited())
+    {
+        if (writeSegment(seg))
+        {
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+            return;
+        }
+    }
+
+    // 没发完，或者前面还有数据没发，排到队尾，等EPOLLOUT时由handleWrite继续发送
+    size_t oldLen = pendingOutputBytes();
+    checkHighWaterMark(oldLen, oldLen + seg.remaining);
+    outputQueue_.push_back(std::move(seg));
+    if (!channel_->isWriting() && !throttled_)
+    {
+        channel_->enableWriting();
+    }
+    updateBackpressure();
 }
- // 实际关闭连接的函数
-void TcpConnection::shutdownInLoop()
+
+bool TcpConnection::writeSegment(OutputSegment &seg)
 {
-    if (!channel_->isWriting()) // 说明outputBuffer中的数据已经全部发送完成
+    while (seg.remaining > 0)
     {
-        socket_->shutdownWrite(); // 关闭写端
+        size_t chunk = std::min(seg.remaining, sendQuota());
+        if (chunk == 0)
+        {
+            return false; // 令牌用完了
+        }
+        ssize_t n = 0;
+        if (seg.payload)
+        {
+            n = ::send(channel_->fd(), seg.payload->data() + seg.offset, chunk, MSG_ZEROCOPY);
+            if (n > 0)
+            {
+                // 内核直接引用了payload的内存，收到完成通知之前必须保持存活
+                zeroCopyPending_.push_back(std::make_pair(zeroCopySeq_++, seg.payload));
+            }
+            else if (n < 0 && errno == ENOBUFS)
+            {
+                // 超过了内核给零拷贝的锁页额度，这一块退回普通的拷贝发送
+                n = ::send(channel_->fd(), seg.payload->data() + seg.offset, chunk, 0);
+            }
+            if (n > 0)
+            {
+                seg.offset += n;
+            }
+        }
+        else
+        {
+            // sendfile会自动推进seg.offset
+            n = ::sendfile(channel_->fd(), seg.fd, &seg.offset, chunk);
+        }
+
+        if (n > 0)
+        {
+            seg.remaining -= n;
+            consumeQuota(n);
+        }
+        else if (n == 0)
+        {
+            // 文件比length短，已经读到文件末尾，剩下的部分没法发送了
+            LOG_ERROR("TcpConnection::sendFile fd=%d reached EOF with %lu bytes left \n", seg.fd, seg.remaining);
+            seg.remaining = 0;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return false; // 内核发送缓冲区满了，等下一次EPOLLOUT
+        }
+        else if (errno == EPIPE || errno == ECONNRESET || seg.payload)
+        {
+            LOG_ERROR("TcpConnection::writeSegment");
+            return false; // 连接已经出错，等poller上报关闭
+        }
+        else
+        {
+            // 文件本身有问题，丢弃这个文件段，否则EPOLLOUT会一直触发
+            LOG_ERROR("TcpConnection::sendFile fd=%d error:%d, drop %lu bytes \n", seg.fd, errno, seg.remaining);
+            seg.remaining = 0;
+        }
     }
+    return true;
 }
 
-// 连接建立函数
-void TcpConnection::connectEstablished()
+bool TcpConnection::setZeroCopyThreshold(size_t threshold)
 {
-    setState(kConnected); // 设置连接的状态
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的epollin事件
+    if (threshold > 0 && zeroCopyThreshold_ == 0 && !socket_->setZeroCopy(true))
+    {
+        LOG_ERROR("TcpConnection::setZeroCopyThreshold [%s] SO_ZEROCOPY not supported \n", name().c_str());
+        return false;
+    }
+    zeroCopyThreshold_ = threshold;
+    return true;
+}
 
-    // 新连接建立，执行回调
-    connectionCallback_(shared_from_this());
+/**
+ * MSG_ZEROCOPY发送完成以后，内核往socket的错误队列里放一条通知，poller上报EPOLLERR
+ * 通知里的[ee_info, ee_data]是这次完成的发送序号区间
+ */
+int TcpConnection::handleZeroCopyCompletions()
+{
+    return drainZeroCopyCompletions(channel_->fd(), zeroCopyPending_);
 }
 
-// 连接销毁
-void TcpConnection::connectDestroyed()
+void TcpConnection::lingerZeroCopy()
 {
-    if (state_ == kConnected)
+    // dup出来的fd让socket在连接销毁以后继续存在，才能读到剩下的完成通知
+    int fd = ::dup(channel_->fd());
+    if (fd < 0)
     {
-        setState(kDisconnected);
-        channel_->disableAll(); // 把channel的所有感兴趣的事件，从poller中del掉
-        connectionCallback_(shared_from_this());
+        LOG_ERROR("TcpConnection::lingerZeroCopy [%s] dup error:%d, %zu payloads released early \n",
+            name().c_str(), errno, zeroCopyPending_.size());
+        return;
     }
-    channel_->remove(); // 把channel从poller中删除掉
+    // 原来的fd关闭时本来会发FIN，dup让关闭推迟了，这里先把FIN发出去
+    ::shutdown(fd, SHUT_WR);
+    int64_t deadline = Timestamp::monotonicMicroSeconds() + kZeroCopyLingerSeconds * Timestamp::kMicroSecondsPerSecond;
+    std::shared_ptr<ZeroCopyLinger> linger = std::make_shared<ZeroCopyLinger>(fd, deadline);
+    linger->pending.swap(zeroCopyPending_);
+    pollZeroCopyLinger(loop_, linger);
 }
 
-// 处理读事件的函数
-void TcpConnection::handleRead(Timestamp receiveTime)
+bool TcpConnection::enableZeroCopyReceive(const ZeroCopyMessageCallback &cb, size_t mapSize)
+{
+    if (zeroCopyRecvAddr_ != nullptr)
+    {
+        zeroCopyMessageCallback_ = cb;
+        return true;
+    }
+    // 映射区域必须是页大小的整数倍
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    mapSize = (mapSize + pageSize - 1) / pageSize * pageSize;
+    void *addr = ::mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, channel_->fd(), 0);
+    if (addr == MAP_FAILED)
+    {
+        LOG_ERROR("TcpConnection::enableZeroCopyReceive [%s] mmap error:%d \n", name().c_str(), errno);
+        return false;
+    }
+    zeroCopyMessageCallback_ = cb;
+    zeroCopyRecvAddr_ = static_cast<char*>(addr);
+    zeroCopyRecvSize_ = mapSize;
+    return true;
+}
+
+void TcpConnection::handleZeroCopyRead(Timestamp receiveTime)
 {
+    struct tcp_zerocopy_receive zc;
+    bzero(&zc, sizeof zc);
+    zc.address = reinterpret_cast<uint64_t>(zeroCopyRecvAddr_);
+    size_t mapLen = zeroCopyRecvSize_;
+    if (readBudget_ < mapLen)
+    {
+        // 映射只能按整页进行，读预算按页向下取整，至少一页
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        mapLen = std::max(readBudget_ / page * page, page);
+    }
+    zc.length = static_cast<uint32_t>(mapLen);
+    socklen_t zcLen = sizeof zc;
+    if (::getsockopt(channel_->fd(), IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zcLen) < 0)
+    {
+        zc.length = 0;
+        zc.recv_skip_hint = 0;
+    }
+
+    if (zc.length > 0)
+    {
+        // 页对齐的数据已经映射到zeroCopyRecvAddr_，直接交给用户
+        zeroCopyMessageCallback_(shared_from_this(), zeroCopyRecvAddr_, zc.length, receiveTime);
+        // 回调返回以后视图失效，把映射的页还给内核
+        ::madvise(zeroCopyRecvAddr_, zc.length, MADV_DONTNEED);
+    }
+
+    ssize_t n = 0;
     int savedErrno = 0;
-    // 调用 inputBuffer_ 的 readFd 方法尝试从套接字读取数据，
-    // 并将数据存储在 inputBuffer_ 中。
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    if (zc.recv_skip_hint > 0)
+    {
+        // 不满一页的部分只能拷贝，只读recv_skip_hint这么多，后面对齐的数据下一次继续映射
+        inputBuffer_.ensureWriteableBytes(zc.recv_skip_hint);
+        n = ::read(channel_->fd(), inputBuffer_.beginWrite(), zc.recv_skip_hint);
+        savedErrno = errno;
+        if (n > 0)
+        {
+            inputBuffer_.hasWritten(n);
+        }
+    }
+    else if (zc.length == 0)
+    {
+        // 没有映射到数据：可能是对端关闭、出错，或者内核没法映射，按普通方式读一次
+        n = inputBuffer_.readFd(channel_->fd(), &savedErrno,
+                                loop_->extraBuffer(), loop_->extraBufferSize(), readBudget_);
+    }
+    else
+    {
+        return;
+    }
+
     if (n > 0)
     {
-        // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        zeroCopyMessageCallback_(shared_from_this(), inputBuffer_.peek(), inputBuffer_.readableBytes(), receiveTime);
+        inputBuffer_.retrieveAll();
     }
     else if (n == 0) // 客户端断开连接
     {
         handleClose();
     }
-    else // n < 0 ，出错error
+    else if (savedErrno != EAGAIN)
     {
         errno = savedErrno;
-        LOG_ERROR("TcpConnection::handleRead");
+        LOG_ERROR("TcpConnection::handleZeroCopyRead");
         handleError();
     }
 }
-// 处理写事件的函数
-void TcpConnection::handleWrite()
+
+bool TcpConnection::outputIdle() const
 {
-    if (channel_->isWriting())
+    return !channel_->isWriting()
+        && outputBuffer_.readableBytes() == 0
+        && outputQueue_.empty()
+        && (!spliceIn_ || spliceIn_->pending == 0);
+}
+
+void TcpConnection::spliceToInLoop(const TcpConnectionPtr &peer)
+{
+    if (peer->getLoop() != loop_)
     {
-        int savedErrno = 0;
-        // 尝试将 outputBuffer_ 中的数据写入到套接字
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-        if (n > 0)
+        LOG_ERROR("TcpConnection::spliceTo [%s] -> [%s] must be in the same loop \n",
+            name().c_str(), peer->name().c_str());
+        return;
+    }
+    if (!peer->spliceIn_)
+    {
+        std::unique_ptr<SplicePipe> pipe(new SplicePipe);
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
         {
-            outputBuffer_.retrieve(n); // 如果成功写入数据，从缓冲区中移除已写入的数据
-            if (outputBuffer_.readableBytes() == 0)  // 检查缓冲区是否还有未读完的数据
-            {
-                channel_->disableWriting(); // 如果缓冲区中的数据已全部写完，禁用写事件
-                // 如果写完成回调函数已设置，调用该回调函数
-                if (writeCompleteCallback_)
-                {
-                    // 唤醒loop_对应的thread线程，执行回调
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this())
-                    );
-                }
-                // 如果当前连接状态为正在断开，调用 shutdownInLoop 函数关闭连接 
-                if (state_ == kDisconnecting)
-                {
-                    shutdownInLoop();
+            LOG_ERROR("TcpConnection::spliceTo pipe2 error:%d \n", errno);
+            return;
+        }
+        pipe->readFd = fds[0];
+        pipe->writeFd = fds[1];
+        peer->spliceIn_ = std::move(pipe);
+    }
+    peer->spliceIn_->source = shared_from_this();
+    spliceTarget_ = peer;
+
+    // 开始转发之前已经读进inputBuffer_的数据，先正常发给peer
+    if (inputBuffer_.readableBytes() > 0)
+    {
+        peer->send(inputBuffer_.retrieveAllAsString());
+    }
+}
+
+void TcpConnection::handleSpliceRead(const TcpConnectionPtr &peer)
+{
+    SplicePipe &pipe = *peer->spliceIn_;
+    ssize_t n = ::splice(channel_->fd(), nullptr, pipe.writeFd, nullptr,
+                         std::min(loop_->extraBufferSize(), readBudget_), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0)
+    {
+        pipe.pending += n;
+        peer->flushSplice();
+    }
+    else if (n == 0) // 客户端断开连接
+    {
+        handleClose();
+        return;
+    }
+    else if (errno != EAGAIN)
+    {
+        LOG_ERROR("TcpConnection::handleSpliceRead");
+        handleError();
+        return;
+    }
+
+    // 管道里还有数据没发出去，说明peer发不动了，先停止读本连接，由peer排空管道以后恢复
+    if (pipe.pending > 0 && channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::flushSplice()
+{
+    SplicePipe &pipe = *spliceIn_;
+    // 自己send的数据还没发完时不能插队，等handleWrite发完以后再来
+    while (pipe.pending > 0 && outputBuffer_.readableBytes() == 0 && outputQueue_.empty())
+    {
+        size_t chunk = std::min(pipe.pending, sendQuota());
+        if (chunk == 0)
+        {
+            break;
+        }
+        ssize_t n = ::splice(pipe.readFd, nullptr, channel_->fd(), nullptr,
+                             chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            pipe.pending -= n;
+            consumeQuota(n);
+        }
+        else
+        {
+            if (errno != EAGAIN)
+            {
+                LOG_ERROR("TcpConnection::flushSplice");
+            }
+            break;
+        }
+    }
+
+    if (pipe.pending > 0)
+    {
+        if (rateLimited() && sendQuota() == 0)
+        {
+            throttleWriting();
+        }
+        else if (!channel_->isWriting() && !throttled_)
+        {
+            channel_->enableWriting();
+        }
+        return;
+    }
+
+    // 管道排空了，恢复源连接的读事件
+    TcpConnectionPtr source = pipe.source.lock();
+    if (source)
+    {
+        source->resumeSpliceRead();
+    }
+}
+
+void TcpConnection::resumeSpliceRead()
+{
+    if (reading_ && !readPaused_ && state_ == kConnected && !channel_->isReading())
+    {
+        channel_->enableReading();
+    }
+}
+
+void TcpConnection::queueOutput(const char *data, size_t len)
+{
+    if (spillThreshold_ > 0)
+    {
+        // 已经在写溢出文件时，内存里不能再放数据，否则会乱序
+        size_t inMemory = spilling() ? spillThreshold_ : bufferedOutputBytes();
+        if (inMemory + len > spillThreshold_)
+        {
+            size_t keep = inMemory < spillThreshold_ ? spillThreshold_ - inMemory : 0;
+            outputTail()->append(data, keep);
+            if (spillToFile(data + keep, len - keep))
+            {
+                return;
+            }
+            // 写文件失败，剩下的数据退回内存
+            data += keep;
+            len -= keep;
+        }
+    }
+    outputTail()->append(data, len);
+}
+
+bool TcpConnection::spillToFile(const char *data, size_t len)
+{
+    if (!spilling())
+    {
+        time_t now = ::time(nullptr);
+        if (now < spillRetryAt_)
+        {
+            return false; // 刚刚失败过，先放在内存里，不要每次send都去open
+        }
+        // O_TMPFILE创建的文件没有名字，关闭以后自动删除；不支持时用mkstemp再unlink
+        int fd = ::open(spillDir_.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            std::string path = spillDir_ + "/mymuduo-spill-XXXXXX";
+            fd = ::mkostemp(&path[0], O_CLOEXEC);
+            if (fd >= 0)
+            {
+                ::unlink(path.c_str());
+            }
+        }
+        if (fd < 0)
+        {
+            LOG_ERROR("TcpConnection::spillToFile [%s] create temp file in %s error:%d \n",
+                name().c_str(), spillDir_.c_str(), errno);
+            spillRetryAt_ = now + 1;
+            return false;
+        }
+        OutputSegment seg;
+        seg.fd = fd;
+        seg.spill = true;
+        outputQueue_.push_back(std::move(seg));
+    }
+
+    // sendfile从offset往后发，所以文件末尾就是offset + remaining
+    OutputSegment &seg = outputQueue_.back();
+    size_t written = 0;
+    while (written < len)
+    {
+        ssize_t n = ::pwrite(seg.fd, data + written, len - written, seg.offset + seg.remaining + written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("TcpConnection::spillToFile [%s] write error:%d \n", name().c_str(), errno);
+            break;
+        }
+        written += n;
+    }
+    seg.remaining += written;
+    if (written < len)
+    {
+        // 写了一半失败，剩下的部分排进文件段的trailer，这个文件不再追加
+        seg.trailer.append(data + written, len - written);
+    }
+    return true;
+}
+
+void TcpConnection::releaseSpilled(OutputSegment &seg)
+{
+    if (seg.offset - seg.released < kSpillReleaseBytes)
+    {
+        return;
+    }
+    // 文件大小不变，只释放已经发出去的块，后面追加的偏移量不受影响
+    if (::fallocate(seg.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, seg.released, seg.offset - seg.released) < 0)
+    {
+        LOG_DEBUG("TcpConnection::releaseSpilled [#%" PRIu64 "] fallocate error:%d \n", id_, errno);
+    }
+    // 文件系统不支持打洞时也不再重试这一段，文件发完关闭时空间一样会释放
+    seg.released = seg.offset;
+}
+
+bool TcpConnection::hasPendingOutput() const
+{
+    return outputBuffer_.readableBytes() > 0
+        || !outputQueue_.empty()
+        || (spliceIn_ && spliceIn_->pending > 0);
+}
+
+void TcpConnection::setSendRateLimit(double bytesPerSecond, size_t burst)
+{
+    if (bytesPerSecond > 0)
+    {
+        // 桶太小时每次只能恢复发送几个字节，定时器会被频繁触发，至少攒够一次恢复的量
+        sendLimiter_.reset(new TokenBucket(bytesPerSecond, std::max(burst, kThrottleResumeBytes)));
+    }
+    else
+    {
+        sendLimiter_.reset();
+    }
+}
+
+size_t TcpConnection::sendQuota()
+{
+    size_t quota = SIZE_MAX;
+    if (sendLimiter_)
+    {
+        quota = sendLimiter_->available();
+    }
+    if (loopLimiter_)
+    {
+        quota = std::min(quota, loopLimiter_->available());
+    }
+    return quota;
+}
+
+void TcpConnection::consumeQuota(size_t n)
+{
+    if (sendLimiter_)
+    {
+        sendLimiter_->consume(n);
+    }
+    if (loopLimiter_)
+    {
+        loopLimiter_->consume(n);
+    }
+}
+
+void TcpConnection::throttleWriting()
+{
+    if (throttled_)
+    {
+        return;
+    }
+    throttled_ = true;
+    if (channel_->isWriting())
+    {
+        channel_->disableWriting();
+    }
+
+    // 两个桶都攒够一小块令牌以后再恢复
+    double delay = 0;
+    if (sendLimiter_)
+    {
+        delay = std::max(delay, sendLimiter_->delayFor(kThrottleResumeBytes));
+    }
+    if (loopLimiter_)
+    {
+        delay = std::max(delay, loopLimiter_->delayFor(kThrottleResumeBytes));
+    }
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    loop_->runAfter(delay, [weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if (conn)
+        {
+            conn->resumeWriting();
+        }
+    });
+}
+
+void TcpConnection::resumeWriting()
+{
+    throttled_ = false;
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    if (hasPendingOutput())
+    {
+        if (!channel_->isWriting())
+        {
+            channel_->enableWriting();
+        }
+    }
+    else if (state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
+}
+
+size_t TcpConnection::bufferedOutputBytes() const
+{
+    size_t bytes = outputBuffer_.readableBytes();
+    for (const OutputSegment &seg : outputQueue_)
+    {
+        bytes += seg.trailer.readableBytes();
+    }
+    return bytes;
+}
+
+size_t TcpConnection::pendingOutputBytes() const
+{
+    size_t bytes = outputBuffer_.readableBytes();
+    for (const OutputSegment &seg : outputQueue_)
+    {
+        bytes += seg.remaining + seg.trailer.readableBytes();
+    }
+    return bytes;
+}
+
+void TcpConnection::checkHighWaterMark(size_t oldLen, size_t newLen)
+{
+    if (newLen >= highWaterMark_
+        && oldLen < highWaterMark_
+        && highWaterMarkCallback_)
+    {
+        // 如果缓冲区数据超过高水位标记且设置了高水位回调，则执行高水位回调
+        loop_->queueInLoop(
+            std::bind(highWaterMarkCallback_, shared_from_this(), newLen)
+        );
+    }
+}
+
+// 关闭连接
+void TcpConnection::shutdown()
+{
+    if (state_ == kConnected)  //检查连接状态是否为已连接
+    {
+        setState(kDisconnecting); // 设置连接状态为正在断开连接
+        loop_->runInLoop(
+            std::bind(&TcpConnection::shutdownInLoop, this)
+        );
+    }
+}
+ // 实际关闭连接的函数
+void TcpConnection::shutdownInLoop()
+{
+    if (!channel_->isWriting() && !throttled_) // 说明outputBuffer中的数据已经全部发送完成
+    {
+        socket_->shutdownWrite(); // 关闭写端
+    }
+}
+
+void TcpConnection::setSocketOptions(const SocketOptions &opts)
+{
+    socket_->applyOptions(opts);
+    quickAck_ = opts.tcpQuickAck;
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::setTcpCork(bool on)
+{
+    socket_->setTcpCork(on);
+}
+
+void TcpConnection::startTcpInfoSampling(double interval, const TcpInfoCallback &cb)
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startTcpInfoSamplingInLoop, shared_from_this(), interval, cb));
+}
+
+void TcpConnection::startTcpInfoSamplingInLoop(double interval, const TcpInfoCallback &cb)
+{
+    stopTcpInfoSamplingInLoop();
+    if (state_ != kConnected || interval <= 0)
+    {
+        return;
+    }
+    tcpInfoCallback_ = cb;
+    tcpInfoSampling_ = true;
+    sampleTcpInfo();
+    // 定时器不能持有连接，否则连接关闭以后也不会析构
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    tcpInfoTimer_ = loop_->runEvery(interval, [weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if (conn)
+        {
+            conn->sampleTcpInfo();
+        }
+    });
+}
+
+void TcpConnection::stopTcpInfoSampling()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopTcpInfoSamplingInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopTcpInfoSamplingInLoop()
+{
+    if (tcpInfoSampling_)
+    {
+        tcpInfoSampling_ = false;
+        loop_->cancel(tcpInfoTimer_);
+    }
+}
+
+void TcpConnection::setAdaptiveSendBuffer(size_t minBytes, size_t maxBytes)
+{
+    // sampleTcpInfo在loop线程里读这两个值
+    loop_->runInLoop(std::bind(&TcpConnection::setAdaptiveSendBufferInLoop, shared_from_this(), minBytes, maxBytes));
+}
+
+void TcpConnection::setAdaptiveSendBufferInLoop(size_t minBytes, size_t maxBytes)
+{
+    adaptiveSndBufMin_ = minBytes;
+    adaptiveSndBufMax_ = std::max(minBytes, maxBytes);
+}
+
+void TcpConnection::sampleTcpInfo()
+{
+    struct tcp_info ti;
+    if (state_ != kConnected || !socket_->getTcpInfo(&ti))
+    {
+        return;
+    }
+    tcpInfo_.sampledAt = Timestamp::monotonicMicroSeconds();
+    tcpInfo_.rtt = ti.tcpi_rtt;
+    tcpInfo_.rttVar = ti.tcpi_rttvar;
+    tcpInfo_.rto = ti.tcpi_rto;
+    tcpInfo_.sndMss = ti.tcpi_snd_mss;
+    tcpInfo_.sndCwnd = ti.tcpi_snd_cwnd;
+    tcpInfo_.sndSsthresh = ti.tcpi_snd_ssthresh;
+    tcpInfo_.unacked = ti.tcpi_unacked;
+    tcpInfo_.lost = ti.tcpi_lost;
+    tcpInfo_.retrans = ti.tcpi_retrans;
+    tcpInfo_.totalRetrans = ti.tcpi_total_retrans;
+    tcpInfo_.pmtu = ti.tcpi_pmtu;
+
+    if (adaptiveSndBufMax_ > 0)
+    {
+        adjustSendBuffer();
+    }
+    tcpInfo_.sndBuf = socket_->getSendBufferSize();
+
+    if (tcpInfoCallback_)
+    {
+        tcpInfoCallback_(shared_from_this(), tcpInfo_);
+    }
+}
+
+void TcpConnection::adjustSendBuffer()
+{
+    // 发送缓冲区要能放下一个拥塞窗口的在途数据，再留一个窗口的余量让cwnd继续增长
+    size_t target = static_cast<size_t>(std::min<uint64_t>(tcpInfo_.bdpBytes() * 2, adaptiveSndBufMax_));
+    target = std::max(target, adaptiveSndBufMin_);
+    // 变化不到1/4就不调整，避免每次采样都setsockopt
+    if (sndBufTarget_ != 0 && target < sndBufTarget_ + sndBufTarget_ / 4 && target > sndBufTarget_ - sndBufTarget_ / 4)
+    {
+        return;
+    }
+    LOG_DEBUG("TcpConnection::adjustSendBuffer [#%" PRIu64 "] cwnd=%u mss=%u rtt=%uus sndbuf %zu => %zu \n",
+        id_, tcpInfo_.sndCwnd, tcpInfo_.sndMss, tcpInfo_.rtt, sndBufTarget_, target);
+    sndBufTarget_ = target;
+    // 内核会把设置的SO_SNDBUF翻倍（多出来的一半算作元数据开销），请求一半才能得到target大小的缓冲区
+    socket_->setSendBufferSize(static_cast<int>(std::min<size_t>(target / 2, INT_MAX)));
+    // 高水位线按内核实际分配的大小算，设置的值可能被net.core.wmem_max截断
+    size_t actual = static_cast<size_t>(std::max(socket_->getSendBufferSize(), 0));
+    highWaterMark_ = std::min(actual * 2, userHighWaterMark_);
+}
+
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+// 连接建立函数
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    reading_ = true;
+    if (!readPaused_ && state_ == kConnected && !channel_->isReading())
+    {
+        channel_->enableReading();
+    }
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    reading_ = false;
+    if (channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::setReadPausedInLoop(bool paused)
+{
+    readPaused_ = paused;
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (paused && channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+    else if (!paused && reading_ && !channel_->isReading())
+    {
+        channel_->enableReading();
+    }
+}
+
+void TcpConnection::setBackpressure(size_t highWaterMark, size_t lowWaterMark, const TcpConnectionPtr &source)
+{
+    backpressureHigh_ = highWaterMark;
+    backpressureLow_ = std::min(lowWaterMark, highWaterMark);
+    if (source)
+    {
+        backpressureSource_ = source;
+    }
+    else
+    {
+        backpressureSource_ = shared_from_this();
+    }
+    updateBackpressure();
+}
+
+void TcpConnection::updateBackpressure()
+{
+    if (backpressureHigh_ == 0)
+    {
+        return;
+    }
+    size_t pending = pendingOutputBytes();
+    bool pause;
+    if (!throttling_ && pending >= backpressureHigh_)
+    {
+        pause = true;
+    }
+    else if (throttling_ && pending <= backpressureLow_)
+    {
+        pause = false;
+    }
+    else
+    {
+        return;
+    }
+
+    throttling_ = pause;
+    TcpConnectionPtr source = backpressureSource_.lock();
+    if (source)
+    {
+        // source在别的loop上时交给它自己的线程去改channel
+        source->loop_->runInLoop(std::bind(&TcpConnection::setReadPausedInLoop, source, pause));
+    }
+}
+
+void TcpConnection::connectEstablished()
+{
+    // 用户回调看到连接之前格式化好名字，之后name()只读，可以在任意线程调用
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%" PRIu64, id_);
+    name_.reserve(namePrefix_->size() + strlen(buf));
+    name_.append(*namePrefix_).append(buf);
+
+    setState(kConnected); // 设置连接的状态
+    channel_->tie(shared_from_this());
+    channel_->enableReading(); // 向poller注册channel的epollin事件
+
+    // 新连接建立，执行回调
+    connectionCallback_(shared_from_this());
+}
+
+// 连接销毁
+void TcpConnection::connectDestroyed()
+{
+    stopTcpInfoSamplingInLoop();
+    if (state_ == kConnected)
+    {
+        setState(kDisconnected);
+        channel_->disableAll(); // 把channel的所有感兴趣的事件，从poller中del掉
+        connectionCallback_(shared_from_this());
+    }
+    // 没收到完成通知的零拷贝payload不能随连接一起释放
+    if (!zeroCopyPending_.empty())
+    {
+        handleZeroCopyCompletions();
+        if (!zeroCopyPending_.empty())
+        {
+            lingerZeroCopy();
+        }
+    }
+    channel_->remove(); // 把channel从poller中删除掉
+}
+
+// 处理读事件的函数
+void TcpConnection::handleRead(Timestamp receiveTime)
+{
+    TcpConnectionPtr peer = spliceTarget_.lock();
+    if (peer)
+    {
+        handleSpliceRead(peer);
+        return;
+    }
+    if (zeroCopyRecvAddr_ != nullptr)
+    {
+        handleZeroCopyRead(receiveTime);
+        return;
+    }
+
+    int savedErrno = 0;
+    // 调用 inputBuffer_ 的 readFd 方法尝试从套接字读取数据，
+    // 并将数据存储在 inputBuffer_ 中，溢出部分先放到loop共用的溢出区
+    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno,
+                                    loop_->extraBuffer(), loop_->extraBufferSize(), readBudget_);
+    if (n > 0)
+    {
+        if (quickAck_)
+        {
+            socket_->setTcpQuickAck(true);
+        }
+        // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+    else if (n == 0) // 客户端断开连接
+    {
+        handleClose();
+    }
+    else // n < 0 ，出错error
+    {
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::handleRead");
+        handleError();
+    }
+}
+// 处理写事件的函数
+void TcpConnection::handleWrite()
+{
+    if (channel_->isWriting())
+    {
+        // 按顺序发送: outputBuffer_ => 文件段 => 文件段后面的trailer => 下一个文件段 ...
+        while (true)
+        {
+            if (outputBuffer_.readableBytes() > 0)
+            {
+                size_t quota = sendQuota();
+                if (quota == 0)
+                {
+                    break; // 令牌用完了
+                }
+                int savedErrno = 0;
+                // 尝试将 outputBuffer_ 中的数据写入到套接字
+                ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno, quota);
+                if (n > 0)
+                {
+                    outputBuffer_.retrieve(n); // 如果成功写入数据，从缓冲区中移除已写入的数据
+                    consumeQuota(n);
                 }
+                else // 如果写入数据失败，记录错误日志
+                {
+                    LOG_ERROR("TcpConnection::handleWrite");
+                }
+                if (outputBuffer_.readableBytes() > 0)
+                {
+                    break; // 内核发送缓冲区已满，等下一次EPOLLOUT
+                }
+            }
+            if (outputQueue_.empty())
+            {
+                break;
+            }
+            if (!writeSegment(outputQueue_.front()))
+            {
+                if (outputQueue_.front().spill)
+                {
+                    releaseSpilled(outputQueue_.front());
+                }
+                break;
+            }
+            // 文件发完了，排在它后面的数据成为新的outputBuffer_
+            if (outputQueue_.front().spill)
+            {
+                ::close(outputQueue_.front().fd);
             }
+            outputBuffer_.swap(outputQueue_.front().trailer);
+            outputQueue_.pop_front();
         }
-        else // 如果写入数据失败，记录错误日志
+        updateBackpressure();
+        // 自己的数据都发完了，再发splice管道里转发过来的数据
+        if (outputBuffer_.readableBytes() == 0 && outputQueue_.empty() && spliceIn_)
         {
-            LOG_ERROR("TcpConnection::handleWrite");
+            flushSplice();
+        }
+
+        if (outputBuffer_.readableBytes() == 0 && outputQueue_.empty()
+            && (!spliceIn_ || spliceIn_->pending == 0))  // 检查是否还有未发送的数据
+        {
+            channel_->disableWriting(); // 如果数据已全部写完，禁用写事件
+            // 如果写完成回调函数已设置，调用该回调函数
+            if (writeCompleteCallback_)
+            {
+                // 唤醒loop_对应的thread线程，执行回调
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+            // 如果当前连接状态为正在断开，调用 shutdownInLoop 函数关闭连接 
+            if (state_ == kDisconnecting)
+            {
+                shutdownInLoop();
+            }
+        }
+        else if (rateLimited() && sendQuota() == 0)
+        {
+            throttleWriting();
         }
     }
     else
@@ -276,10 +1460,34 @@ void TcpConnection::handleWrite()
 // poller => channel::closeCallback => TcpConnection::handleClose
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
     setState(kDisconnected);
     channel_->disableAll();
 
+    // 本连接不会再发数据了，不能让被背压的source一直停着
+    if (throttling_)
+    {
+        backpressureHigh_ = 0;
+        throttling_ = false;
+        TcpConnectionPtr source = backpressureSource_.lock();
+        if (source && source.get() != this)
+        {
+            source->loop_->runInLoop(std::bind(&TcpConnection::setReadPausedInLoop, source, false));
+        }
+    }
+    // 管道里剩下的数据发不出去了，源连接不能再splice过来，也不能因为等管道排空一直停着读，
+    // 否则它永远看不到自己的EOF/RST，连接和fd都泄漏；源连接和本连接在同一个loop里
+    if (spliceIn_)
+    {
+        TcpConnectionPtr source = spliceIn_->source.lock();
+        spliceIn_.reset();
+        if (source && source.get() != this)
+        {
+            source->spliceTarget_.reset();
+            source->resumeSpliceRead();
+        }
+    }
+
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr); // 执行连接关闭的回调
     closeCallback_(connPtr); // 关闭连接的回调  执行的是TcpServer::removeConnection回调方法
@@ -287,6 +1495,12 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+    // 零拷贝的完成通知也是通过EPOLLERR上报的，不是真正的错误
+    if ((zeroCopyThreshold_ > 0 || !zeroCopyPending_.empty()) && handleZeroCopyCompletions() > 0)
+    {
+        return;
+    }
+
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
@@ -298,5 +1512,5 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
+    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name().c_str(), err);
 }
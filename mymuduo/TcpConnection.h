@@ -5,14 +5,22 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "TcpInfo.h"
+#include "TimerId.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <deque>
+#include <stdint.h>
+#include <sys/types.h>
 
 class Channel;
 class EventLoop;
 class Socket;
+class TokenBucket;
+struct SocketOptions;
+struct iovec;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -22,24 +30,101 @@ class Socket;
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
 public:
+    // 同一个TcpServer/TcpClient的所有连接共用一个名字前缀，建立连接时不拷贝字符串
+    using NamePrefixPtr = std::shared_ptr<const std::string>;
+
     TcpConnection(EventLoop *loop, 
-                const std::string &name, 
+                uint64_t id,
+                const NamePrefixPtr &namePrefix, 
                 int sockfd,
                 const InetAddress& localAddr,
                 const InetAddress& peerAddr);
     ~TcpConnection();
 
     EventLoop* getLoop() const { return loop_; }
+    uint64_t id() const { return id_; }
+    // 名字是"前缀#id"，不在accept路径上格式化，connectEstablished里在本连接的loop线程格式化一次，之后任意线程只读
     const std::string& name() const { return name_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
 
-    // 发送数据
+    // 暂停/恢复读取对端数据，暂停期间数据留在内核接收缓冲区里，由TCP流控让对端慢下来
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    // 自动背压：本连接排队的待发送数据达到highWaterMark时暂停读source，降到lowWaterMark以下再恢复
+    // source默认是本连接自己（echo类服务），代理可以传入上游连接，source可以在别的loop上
+    // 需要在loop线程里调用（比如connectionCallback中），highWaterMark为0表示关闭
+    void setBackpressure(size_t highWaterMark, size_t lowWaterMark,
+                         const TcpConnectionPtr &source = TcpConnectionPtr());
+
+    // 发送数据，跨线程调用时会拷贝一份交给loop线程
     void send(const std::string &buf);
+    // 下面三个接口把数据的所有权直接转移给loop线程，跨线程发送也不需要拷贝
+    void send(std::string &&buf);
+    void send(Buffer &&buf);
+    // 多个连接共享同一份只读数据（比如广播），只增加引用计数
+    void send(const PayloadPtr &payload);
+    // 用sendfile把文件fd从offset开始的length字节发给对端，数据不经过用户态
+    // 和前后send的数据保持顺序；fd由调用方持有，writeCompleteCallback之前不能关闭
+    void sendFile(int fd, off_t offset, size_t length);
+
+    // 开启MSG_ZEROCOPY发送，大于等于threshold的PayloadPtr不再拷贝进内核，0表示关闭
+    // 需要在loop线程里调用（比如connectionCallback中），内核不支持时返回false
+    // 内核发完（收到完成通知）之前一直持有payload，连接关闭以后最多再等10秒；payload的内容不能被修改
+    bool setZeroCopyThreshold(size_t threshold);
+
+    // 把本连接收到的数据经过管道splice给peer，数据不进入用户态，适合做TCP代理
+    // peer必须和本连接在同一个loop上；管道里的数据发不出去时自动停止读本连接，排空后再恢复
+    // 双向转发需要两边都调用；转发期间不要再对peer调用send，两路数据之间不保证顺序
+    void spliceTo(const TcpConnectionPtr &peer);
+
+    // 开启输出溢出到文件：内存中排队的输出超过threshold以后，后续数据写进dir下的匿名临时文件，
+    // 再用sendfile发送，慢消费者占用的是磁盘而不是内存。0表示关闭，需要在loop线程里调用
+    // 溢出文件里的数据同样计入高水位线和背压，用它们限制磁盘占用
+    void setOutputSpill(size_t threshold, const std::string &dir = "/tmp")
+    { spillThreshold_ = threshold; spillDir_ = dir; }
+
+    // 每次可读事件最多读maxBytes字节，0表示不限制。epoll是水平触发的，没读完的数据下一轮poll会再次上报，
+    // 一个疯狂发数据的连接不会长时间占着loop，同一个loop上其它连接的延迟是有上限的
+    void setReadBudget(size_t maxBytes) { readBudget_ = maxBytes > 0 ? maxBytes : SIZE_MAX; }
+
+    // 出口限速：每秒最多发送bytesPerSecond字节，允许burst字节（至少16K）的突发，bytesPerSecond为0表示关闭
+    // 令牌用完时数据留在输出缓冲区里，暂停EPOLLOUT，令牌补充以后由定时器恢复；需要在loop线程里调用
+    void setSendRateLimit(double bytesPerSecond, size_t burst);
+    // 同一个loop上的连接共享的限速桶，和连接自己的限速同时生效，由TcpServer在连接建立前设置
+    void setLoopRateLimiter(const std::shared_ptr<TokenBucket> &limiter) { loopLimiter_ = limiter; }
+
+    // 开启TCP_ZEROCOPY_RECEIVE接收，适合大块上传的连接：页对齐的数据直接映射到mapSize大小的只读区域，
+    // 不满一页的剩余部分退回read拷贝。开启以后所有数据按顺序交给cb，不再走messageCallback_
+    // 需要在loop线程里调用，内核不支持时返回false
+    bool enableZeroCopyReceive(const ZeroCopyMessageCallback &cb, size_t mapSize = 2 * 1024 * 1024);
+    // 聚集发送，比如协议头+协议体，一次writev发出去，不需要先拼接成一个string
+    // 只有内核没收下的那部分才会拷贝到outputBuffer_
+    void send(const struct iovec *iov, int iovcnt);
+    // 设置连接socket的调优选项，见SocketOptions
+    void setSocketOptions(const SocketOptions &opts);
+    void setTcpNoDelay(bool on);
+    // 打开以后小块数据先在内核里攒着，关闭时一起发出去，适合连续几次send组成一个响应的场景
+    void setTcpCork(bool on);
+
+    // 每interval秒采样一次TCP_INFO，结果用tcpInfo()读取，cb不为空时每次采样以后调用
+    void startTcpInfoSampling(double interval, const TcpInfoCallback &cb = TcpInfoCallback());
+    void stopTcpInfoSampling();
+    // 最近一次采样的结果，在loop线程里读取
+    const TcpInfo& tcpInfo() const { return tcpInfo_; }
+    // 每次采样以后按带宽时延积调整SO_SNDBUF：目标是2倍拥塞窗口，限制在[minBytes, maxBytes]
+    // 高水位线同时调整为SO_SNDBUF的2倍，但不超过setHighWaterMarkCallback设置的值
+    // 设置SO_SNDBUF以后内核不再自动调整发送缓冲区；需要配合startTcpInfoSampling使用
+    void setAdaptiveSendBuffer(size_t minBytes, size_t maxBytes);
+
     // 关闭连接
     void shutdown();
+    // 不等待outputBuffer_发完，直接关闭连接
+    void forceClose();
 
     void setConnectionCallback(const ConnectionCallback& cb)
     { connectionCallback_ = cb; }
@@ -51,7 +136,7 @@ public:
     { writeCompleteCallback_ = cb; }
 
     void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
-    { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+    { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; userHighWaterMark_ = highWaterMark; }
 
     void setCloseCallback(const CloseCallback& cb)
     { closeCallback_ = cb; }
@@ -70,12 +155,96 @@ private:
     void handleError();
 
     void sendInLoop(const void* message, size_t len);
+    void sendInLoop(const std::string &message);
+    void sendInLoop(Buffer &buf);
+    void sendInLoop(const PayloadPtr &payload);
+    // spare不为空时，没发完的部分直接把spare换进outputBuffer_，不再拷贝
+    void sendInLoop(const struct iovec *iov, int iovcnt, Buffer *spare = nullptr);
+    void sendFileInLoop(int fd, off_t offset, size_t length);
+    void spliceToInLoop(const TcpConnectionPtr &peer);
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void startTcpInfoSamplingInLoop(double interval, const TcpInfoCallback &cb);
+    void stopTcpInfoSamplingInLoop();
+    void sampleTcpInfo();
+    void setAdaptiveSendBufferInLoop(size_t minBytes, size_t maxBytes);
+    void adjustSendBuffer();
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 下游连接背压时暂停/恢复本连接的读事件，和用户的startRead/stopRead互不覆盖
+    void setReadPausedInLoop(bool paused);
+    // 根据排队的数据量暂停或者恢复背压的source
+    void updateBackpressure();
+
+    // 排队等待发送的输出段：payload为空时是sendFile的文件段，否则是零拷贝发送的payload
+    // trailer是排在这个段之后、下一个段之前send的数据
+    struct OutputSegment
+    {
+        OutputSegment() : fd(-1), offset(0), remaining(0), spill(false), released(0) {}
+
+        int fd;
+        off_t offset;
+        size_t remaining;
+        PayloadPtr payload;
+        bool spill; // 连接自己创建的溢出文件，发完以后由连接关闭
+        off_t released; // 溢出文件里[0, released)已经发送并把磁盘空间还给了文件系统
+        Buffer trailer;
+    };
+    // 前面没有排队的数据就直接发送，否则排到outputQueue_队尾
+    void sendSegmentInLoop(OutputSegment &seg);
+    // 用sendfile/MSG_ZEROCOPY尽量多地发送一个段，整段发完返回true
+    bool writeSegment(OutputSegment &seg);
+    // 读取socket错误队列里的零拷贝完成通知，释放内核已经用完的payload，返回处理的通知个数
+    int handleZeroCopyCompletions();
+    // 连接销毁时内核可能还在从零拷贝payload的页上发送（包括重传），把payload交给loop留到完成通知到达再释放
+    void lingerZeroCopy();
+    // 新send的数据应该追加到哪个缓冲区，有文件在排队时要排在最后一个文件后面
+    Buffer* outputTail() { return outputQueue_.empty() ? &outputBuffer_ : &outputQueue_.back().trailer; }
+    // 内存中排队的待发送数据总量，用来决定是否溢出到文件
+    size_t bufferedOutputBytes() const;
+    // 所有排队的待发送数据，包括文件段、零拷贝段和溢出文件，高水位线和背压按这个判断
+    size_t pendingOutputBytes() const;
+    // 排队的数据量从oldLen涨到newLen，跨过高水位线时回调一次
+    void checkHighWaterMark(size_t oldLen, size_t newLen);
+    // 把没发出去的数据排进输出队列，超过溢出阈值的部分写进临时文件
+    void queueOutput(const char *data, size_t len);
+    // 正在往队尾的溢出文件里追加数据，后续数据也必须写进文件才能保持顺序
+    bool spilling() const
+    { return !outputQueue_.empty() && outputQueue_.back().spill && outputQueue_.back().trailer.readableBytes() == 0; }
+    // 追加到队尾的溢出文件，没有就新建一个，失败返回false
+    bool spillToFile(const char *data, size_t len);
+    // 溢出文件已经发出去的部分攒够一定大小时打洞释放磁盘空间
+    void releaseSpilled(OutputSegment &seg);
+    // 没有任何排队的输出，可以直接往socket写
+    bool outputIdle() const;
+    // 还有数据等着发送
+    bool hasPendingOutput() const;
+
+    bool rateLimited() const { return sendLimiter_ || loopLimiter_; }
+    // 限速允许现在发送的字节数，不限速时返回SIZE_MAX
+    size_t sendQuota();
+    void consumeQuota(size_t n);
+    // 令牌用完了，暂停EPOLLOUT，定时器到期以后resumeWriting
+    void throttleWriting();
+    void resumeWriting();
+
+    // 从socket splice进peer的管道，代替readFd
+    void handleSpliceRead(const TcpConnectionPtr &peer);
+    // 零拷贝接收模式下代替readFd
+    void handleZeroCopyRead(Timestamp receiveTime);
+    // 把管道里的数据splice到socket，排空以后恢复源连接的读事件
+    void flushSplice();
+    // splice源连接因为管道没排空停止了读，在这里恢复（用户stopRead或者背压暂停时除外）
+    void resumeSpliceRead();
+    struct SplicePipe;
 
     EventLoop *loop_; // 这里绝对不是baseLoop， 因为TcpConnection都是在subLoop里面管理的
-    const std::string name_;
+    const uint64_t id_;
+    NamePrefixPtr namePrefix_;
+    std::string name_; // connectEstablished之前为空
     std::atomic_int state_;
-    bool reading_;
+    bool reading_; // 用户是否要读，stopRead以后为false
+    bool readPaused_; // 被下游连接背压暂停
 
     // 这里和Acceptor类似   Acceptor=》mainLoop    TcpConenction=》subLoop
     std::unique_ptr<Socket> socket_;
@@ -90,7 +259,42 @@ private:
     HighWaterMarkCallback highWaterMarkCallback_;
     CloseCallback closeCallback_;
     size_t highWaterMark_;
+    size_t userHighWaterMark_; // 用户设置的高水位线，自动调整时不超过它
+
+    size_t backpressureHigh_; // 0表示不做背压
+    size_t backpressureLow_;
+    std::weak_ptr<TcpConnection> backpressureSource_;
+    bool throttling_; // 已经暂停了backpressureSource_
 
+    size_t readBudget_; // 每次可读事件最多读多少字节
+    bool quickAck_; // 每次读完重新打开TCP_QUICKACK
+
+    TcpInfo tcpInfo_;
+    TcpInfoCallback tcpInfoCallback_;
+    TimerId tcpInfoTimer_;
+    bool tcpInfoSampling_;
+    size_t adaptiveSndBufMin_;
+    size_t adaptiveSndBufMax_; // 0表示不自动调整
+    size_t sndBufTarget_; // 上一次调整的目标大小，即内核实际分配的SO_SNDBUF
     Buffer inputBuffer_;  // 接收数据的缓冲区
     Buffer outputBuffer_; // 发送数据的缓冲区
+    std::deque<OutputSegment> outputQueue_; // outputBuffer_之后排队的文件段、零拷贝段、溢出文件段
+    size_t spillThreshold_; // 0表示不溢出到文件
+    std::string spillDir_;
+    time_t spillRetryAt_; // 创建溢出文件失败以后，这个时间之前不再尝试
+
+    size_t zeroCopyThreshold_; // 0表示不使用零拷贝发送
+    uint32_t zeroCopySeq_; // 内核给每次成功的MSG_ZEROCOPY发送分配的序号，从0开始递增
+    std::deque<std::pair<uint32_t, PayloadPtr>> zeroCopyPending_; // 内核还在引用的payload
+
+    std::weak_ptr<TcpConnection> spliceTarget_; // 本连接的数据splice给谁
+    std::unique_ptr<SplicePipe> spliceIn_; // 别的连接splice给本连接的数据先进这个管道
+
+    std::unique_ptr<TokenBucket> sendLimiter_; // 本连接的限速
+    std::shared_ptr<TokenBucket> loopLimiter_; // 所在loop共享的限速
+    bool throttled_; // 因为限速暂停了EPOLLOUT
+
+    ZeroCopyMessageCallback zeroCopyMessageCallback_;
+    char *zeroCopyRecvAddr_; // TCP_ZEROCOPY_RECEIVE映射区域，nullptr表示没有开启
+    size_t zeroCopyRecvSize_;
 };
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * 一次getsockopt(TCP_INFO)采样的结果，TcpConnection::startTcpInfoSampling定期更新
+ * 时间单位都是微秒，窗口和在途数据的单位是报文段（乘以sndMss就是字节数）
+ */ 
+struct TcpInfo
+{
+    TcpInfo()
+        : sampledAt(0), rtt(0), rttVar(0), rto(0)
+        , sndMss(0), sndCwnd(0), sndSsthresh(0)
+        , unacked(0), lost(0), retrans(0), totalRetrans(0)
+        , pmtu(0), sndBuf(0)
+    {}
+
+    // 拥塞窗口对应的字节数，近似为当前的带宽时延积
+    uint64_t bdpBytes() const { return static_cast<uint64_t>(sndCwnd) * sndMss; }
+
+    int64_t sampledAt;      // 单调时钟微秒，0表示还没有采样过
+    uint32_t rtt;           // 平滑往返时间
+    uint32_t rttVar;
+    uint32_t rto;
+    uint32_t sndMss;
+    uint32_t sndCwnd;
+    uint32_t sndSsthresh;
+    uint32_t unacked;       // 已发出还没确认的报文段
+    uint32_t lost;
+    uint32_t retrans;       // 当前正在重传的报文段
+    uint32_t totalRetrans;  // 连接建立以来重传的报文段总数
+    uint32_t pmtu;
+    int sndBuf;             // 当前的SO_SNDBUF，内核实际分配的大小
+};
@@ -3,7 +3,13 @@
 #include "TcpConnection.h"
 
 #include <strings.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include <functional>
+#include <algorithm>
+
+// loop共享限速桶的最小容量，和TcpConnection限速以后恢复发送的粒度一致
+static const size_t kMinLoopSendBurst = 16 * 1024;
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -21,12 +27,25 @@ TcpServer::TcpServer(EventLoop *loop,
                 : loop_(CheckLoopNotNull(loop))
                 , ipPort_(listenAddr.toIpPort())
                 , name_(nameArg)
+                , namePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_))
                 , acceptor_(new Acceptor(loop, listenAddr, option == kReusePort))
                 , threadPool_(new EventLoopThreadPool(loop, name_))
                 , connectionCallback_()
                 , messageCallback_()
                 , nextConnId_(1)
                 , started_(0)
+                , readBudget_(0)
+                , loopRateLimit_(0)
+                , loopRateBurst_(0)
+                , maxConnections_(0)
+                , maxConnectionsPerIp_(0)
+                , acceptResumeAt_(0)
+                , maxLoopLag_(0)
+                , lagProbeInterval_(0.1)
+                , maxLoopLagMeasured_(0)
+                , connectionCount_(0)
+                , rejectedCount_(0)
+                , acceptPaused_(false)
 {
     // 当有先用户连接时，会执行TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
@@ -35,20 +54,55 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
-    for (auto &item : connections_)
+    loop_->cancel(lagProbeTimer_);
+    loop_->cancel(acceptResumeTimer_);
+    // 连接表只能在各自的loop线程里访问，交给每个loop自己销毁；registry随任务一起转移，不需要等待
+    for (auto &item : registries_)
     {
-        // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
-        TcpConnectionPtr conn(item.second); 
-        item.second.reset();
+        std::shared_ptr<ConnectionRegistry> registry(std::move(item.second));
+        item.first->runInLoop([registry]() {
+            destroyConnections(registry.get());
+        });
+    }
+}
 
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn)
-        );
+void TcpServer::destroyConnections(ConnectionRegistry *registry)
+{
+    for (TcpConnectionPtr &conn : registry->slots)
+    {
+        if (conn)
+        {
+            // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
+            TcpConnectionPtr guard(conn);
+            conn.reset();
+            guard->connectDestroyed();
+        }
     }
+    registry->slots.clear();
+    registry->freeSlots.clear();
+}
+
+void TcpServer::setAcceptRateLimit(double connectionsPerSecond, size_t burst)
+{
+    acceptLimiter_.reset(new TokenBucket(connectionsPerSecond, burst));
+}
+
+void TcpServer::setMaxLoopLag(double maxLagSeconds, double probeInterval)
+{
+    maxLoopLag_ = static_cast<int64_t>(maxLagSeconds * Timestamp::kMicroSecondsPerSecond);
+    lagProbeInterval_ = probeInterval;
 }
 
 // 设置底层subloop的个数
+void TcpServer::setSocketOptions(const SocketOptions &opts)
+{
+    acceptor_->setSocketOptions(opts);
+    // SO_SNDBUF/SO_RCVBUF已经设置在监听socket上，accept出来的连接会继承，不用每个连接再设置一遍
+    socketOptions_ = opts;
+    socketOptions_.sendBufferSize = 0;
+    socketOptions_.recvBufferSize = 0;
+}
+
 void TcpServer::setThreadNum(int numThreads)
 {
     threadPool_->setThreadNum(numThreads);
@@ -60,6 +114,14 @@ void TcpServer::start()
     if (started_++ == 0) // 防止一个TcpServer对象被start多次
     {
         threadPool_->start(threadInitCallback_); // 启动底层的loop线程池
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            registries_[ioLoop] = std::make_shared<ConnectionRegistry>();
+        }
+        if (maxLoopLag_ > 0)
+        {
+            lagProbeTimer_ = loop_->runEvery(lagProbeInterval_, std::bind(&TcpServer::probeLoopLag, this));
+        }
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
@@ -67,16 +129,44 @@ void TcpServer::start()
 // 有一个新的客户端的连接，acceptor会执行这个回调操作
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
+    // 准入控制：Acceptor暂停之前已经在这一批里accept的连接，超过上限的直接关闭
+    uint32_t peerIp = peerAddr.getSockAddr()->sin_addr.s_addr;
+    if (maxConnections_ > 0 && connectionCount_ >= maxConnections_)
+    {
+        LOG_DEBUG("TcpServer::newConnection [%s] - reject %s, too many connections \n",
+            name_.c_str(), peerAddr.toIpPort().c_str());
+        ::close(sockfd);
+        ++rejectedCount_;
+        updateAccepting();
+        return;
+    }
+    if (maxConnectionsPerIp_ > 0)
+    {
+        std::lock_guard<std::mutex> lock(ipMutex_);
+        size_t &count = ipCounts_[peerIp];
+        if (count >= maxConnectionsPerIp_)
+        {
+            LOG_DEBUG("TcpServer::newConnection [%s] - reject %s, too many connections from this ip \n",
+                name_.c_str(), peerAddr.toIpPort().c_str());
+            ::close(sockfd);
+            ++rejectedCount_;
+            return;
+        }
+        ++count;
+    }
+    ++connectionCount_;
+    if (acceptLimiter_)
+    {
+        acceptLimiter_->consume(1);
+    }
+
     // 轮询算法，选择一个subLoop，来管理channel
     EventLoop *ioLoop = threadPool_->getNextLoop(); 
-    // 生成一个唯一连接的名称
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+    // 连接只分配一个整数id，名字等第一次用到时再格式化
+    uint64_t connId = nextConnId_++;
 
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-        name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+    LOG_DEBUG("TcpServer::newConnection [%s] - new connection #%" PRIu64 " from %s \n",
+        name_.c_str(), connId, peerAddr.toIpPort().c_str());
 
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
     sockaddr_in local;
@@ -91,45 +181,151 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     // 根据连接成功的sockfd，创建TcpConnection连接对象
     TcpConnectionPtr conn(new TcpConnection(
                             ioLoop,
-                            connName,
+                            connId,
+                            namePrefix_,
                             sockfd,   // Socket Channel
                             localAddr,
                             peerAddr));
-    connections_[connName] = conn;
     // 下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setReadBudget(readBudget_);
+    conn->setSocketOptions(socketOptions_);
+    if (loopRateLimit_ > 0)
+    {
+        // 同一个subloop上的连接共用一个桶，桶只在这个subloop的线程里使用
+        std::shared_ptr<TokenBucket> &limiter = loopLimiters_[ioLoop];
+        if (!limiter)
+        {
+            limiter = std::make_shared<TokenBucket>(loopRateLimit_, std::max(loopRateBurst_, kMinLoopSendBurst));
+        }
+        conn->setLoopRateLimiter(limiter);
+    }
 
-    // 设置了如何关闭连接的回调   conn->shutDown()
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)
-    );
+    // 登记、设置关闭回调、建立连接都在ioLoop里完成
+    ConnectionRegistry *registry = registries_.find(ioLoop)->second.get();
+    ioLoop->runInLoop(std::bind(&TcpServer::connectEstablishedInLoop, this, registry, conn));
 
-    // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    if (maxConnections_ > 0 || acceptLimiter_)
+    {
+        updateAccepting();
+    }
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::connectEstablishedInLoop(ConnectionRegistry *registry, const TcpConnectionPtr &conn)
 {
-    // this->removeConnectionInLoop(conn); 相当于这个意思
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn)
+    size_t slot;
+    if (!registry->freeSlots.empty())
+    {
+        slot = registry->freeSlots.back();
+        registry->freeSlots.pop_back();
+        registry->slots[slot] = conn;
+    }
+    else
+    {
+        slot = registry->slots.size();
+        registry->slots.push_back(conn);
+    }
+
+    // 设置了如何关闭连接的回调   conn->shutDown()
+    conn->setCloseCallback(
+        std::bind(&TcpServer::removeConnectionInLoop, this, registry, slot, std::placeholders::_1)
     );
+    conn->connectEstablished();
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+// TcpConnection::handleClose调用，已经在conn所属的loop线程里了
+void TcpServer::removeConnectionInLoop(ConnectionRegistry *registry, size_t slot, const TcpConnectionPtr &conn)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n", 
-        name_.c_str(), conn->name().c_str());
+    LOG_DEBUG("TcpServer::removeConnectionInLoop [%s] - connection #%" PRIu64 "\n", 
+        name_.c_str(), conn->id());
+
+    registry->slots[slot].reset();
+    registry->freeSlots.push_back(slot);
 
-    connections_.erase(conn->name());
-    EventLoop *ioLoop = conn->getLoop(); 
-    ioLoop->queueInLoop(
+    --connectionCount_;
+    if (maxConnectionsPerIp_ > 0)
+    {
+        std::lock_guard<std::mutex> lock(ipMutex_);
+        auto it = ipCounts_.find(conn->peerAddress().getSockAddr()->sin_addr.s_addr);
+        if (it != ipCounts_.end() && --it->second == 0)
+        {
+            ipCounts_.erase(it);
+        }
+    }
+    if (acceptPaused_)
+    {
+        // 可能是因为连接数满了暂停的，回到mainLoop重新判断
+        loop_->queueInLoop(std::bind(&TcpServer::updateAccepting, this));
+    }
+    conn->getLoop()->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn)
         // 相当于 conn->connectDestroyed();
     );
 }
+void TcpServer::probeLoopLag()
+{
+    int64_t now = Timestamp::monotonicMicroSeconds();
+    int64_t maxLag = 0;
+    for (auto &item : registries_)
+    {
+        std::shared_ptr<ConnectionRegistry> registry = item.second;
+        int64_t sentAt = registry->probeSentAt;
+        if (sentAt != 0)
+        {
+            // 上一次的探测任务还在排队，延迟至少有这么多
+            maxLag = std::max(maxLag, now - sentAt);
+            continue;
+        }
+        maxLag = std::max(maxLag, registry->lag.load());
+        registry->probeSentAt = now;
+        item.first->queueInLoop([registry]() {
+            registry->lag = Timestamp::monotonicMicroSeconds() - registry->probeSentAt;
+            registry->probeSentAt = 0;
+        });
+    }
+    maxLoopLagMeasured_ = maxLag;
+    updateAccepting();
+}
+
+void TcpServer::updateAccepting()
+{
+    bool full = maxConnections_ > 0 && connectionCount_ >= maxConnections_;
+    bool lagging = maxLoopLag_ > 0 && maxLoopLagMeasured_ > maxLoopLag_;
+    bool rateLimited = false;
+    if (acceptLimiter_ && acceptLimiter_->available() == 0)
+    {
+        rateLimited = true;
+        int64_t now = Timestamp::monotonicMicroSeconds();
+        if (acceptResumeAt_ <= now) // 还没有安排恢复
+        {
+            double delay = acceptLimiter_->delayFor(1);
+            acceptResumeAt_ = now + static_cast<int64_t>(delay * Timestamp::kMicroSecondsPerSecond);
+            acceptResumeTimer_ = loop_->runAfter(delay, std::bind(&TcpServer::updateAccepting, this));
+        }
+    }
+
+    bool pause = full || lagging || rateLimited;
+    if (pause == acceptPaused_)
+    {
+        return;
+    }
+    acceptPaused_ = pause;
+    if (pause)
+    {
+        acceptor_->pause();
+        LOG_INFO("TcpServer [%s] - pause accepting, connections=%zu lag=%.3fs rateLimited=%d \n",
+            name_.c_str(), connectionCount_.load(), loopLag(), (int)rateLimited);
+    }
+    else
+    {
+        acceptor_->resume();
+        LOG_INFO("TcpServer [%s] - resume accepting, connections=%zu lag=%.3fs \n",
+            name_.c_str(), connectionCount_.load(), loopLag());
+    }
+}
+
 /*
 +-----------------+
 | TcpServer       |
@@ -144,14 +340,14 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
          |
          v
 +-------------------------+
-| Generate connection name|
-| connName = name_ + buf  |
+| Allocate connection id  |
+| connId = nextConnId_++  |
 +-------------------------+
          |
          v
 +-----------------------+
 | Log connection info   |
-| LOG_INFO(...)         |
+| LOG_DEBUG(...)        |
 +-----------------------+
          |
          v
@@ -172,13 +368,12 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
 | setConnectionCallback(...)     |
 | setMessageCallback(...)        |
 | setWriteCompleteCallback(...)  |
-| setCloseCallback(...)          |
 +--------------------------------+
          |
          v
-+------------------------------------+
-| Notify connection established      |
-| ioLoop->runInLoop(connectEstablished)|
-+------------------------------------+
++----------------------------------------------+
+| Register in ioLoop's slab, set close callback|
+| ioLoop->runInLoop(connectEstablishedInLoop)  |
++----------------------------------------------+
 
 */
\ No newline at end of file
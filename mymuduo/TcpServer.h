@@ -11,12 +11,17 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "TokenBucket.h"
+#include "SocketOptions.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
 
 // 对外的服务器编程使用的类
 class TcpServer : noncopyable
@@ -44,19 +49,70 @@ public:
     // 设置底层subloop的个数
     void setThreadNum(int numThreads);
 
+    // 新连接的读预算，见TcpConnection::setReadBudget
+    void setReadBudget(size_t maxBytes) { readBudget_ = maxBytes; }
+
+    // 每个subloop上所有连接的出口总带宽上限，burst至少16K，在start之前调用；单个连接的限速在connectionCallback里设置
+    void setLoopSendRateLimit(double bytesPerSecond, size_t burst)
+    { loopRateLimit_ = bytesPerSecond; loopRateBurst_ = burst; }
+
+    // 监听socket和每个新连接的调优选项，在start之前调用
+    void setSocketOptions(const SocketOptions &opts);
+
+    // 每次listenfd可读时最多accept的连接数，在start之前调用
+    void setAcceptBatch(int batch) { acceptor_->setAcceptBatch(batch); }
+    // accept的统计计数，可以在任意线程读取
+    uint64_t acceptedConnections() const { return acceptor_->acceptedCount(); }
+    uint64_t droppedConnections() const { return acceptor_->droppedCount(); }
+
+    // 准入控制，都在start之前调用，0表示不限制
+    // 连接总数到达上限时暂停accept，有连接关闭以后恢复
+    void setMaxConnections(size_t maxConnections) { maxConnections_ = maxConnections; }
+    // 单个对端IP的连接数上限，超过的新连接直接关闭，不影响其他IP
+    void setMaxConnectionsPerIp(size_t maxPerIp) { maxConnectionsPerIp_ = maxPerIp; }
+    // 每秒最多accept的连接数，超过以后暂停accept，攒够令牌再恢复
+    void setAcceptRateLimit(double connectionsPerSecond, size_t burst);
+    // 每probeInterval秒往每个subloop投递一个空任务，排队延迟超过maxLag秒时暂停accept
+    void setMaxLoopLag(double maxLagSeconds, double probeInterval = 0.1);
+
+    size_t connectionCount() const { return connectionCount_; }
+    // 被连接数上限拒绝的连接
+    uint64_t rejectedConnections() const { return rejectedCount_; }
+    // 最近一次测量到的subloop最大排队延迟，单位秒
+    double loopLag() const { return maxLoopLagMeasured_ / 1000000.0; }
+
     // 开启服务器监听
     void start();
 private:
-    void newConnection(int sockfd, const InetAddress &peerAddr);
-    void removeConnection(const TcpConnectionPtr &conn);
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    // 每个loop自己的连接表，只在这个loop的线程里访问，连接的建立和销毁不用再回到mainLoop
+    // 下标分配：释放的槽位放进freeSlots，下次优先复用
+    struct ConnectionRegistry
+    {
+        ConnectionRegistry() : probeSentAt(0), lag(0) {}
 
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+        std::vector<TcpConnectionPtr> slots;
+        std::vector<size_t> freeSlots;
+        // 延迟探测，mainLoop写probeSentAt，subloop执行探测任务时写lag，单调时钟微秒
+        std::atomic<int64_t> probeSentAt; // 0表示没有在途的探测
+        std::atomic<int64_t> lag;
+    };
+
+    void newConnection(int sockfd, const InetAddress &peerAddr);
+    // 在conn所属的loop里执行，登记到registry以后建立连接
+    void connectEstablishedInLoop(ConnectionRegistry *registry, const TcpConnectionPtr &conn);
+    // 连接关闭时在conn所属的loop里执行，slot是它在registry里的下标
+    void removeConnectionInLoop(ConnectionRegistry *registry, size_t slot, const TcpConnectionPtr &conn);
+    static void destroyConnections(ConnectionRegistry *registry);
+    // 下面两个在mainLoop里执行
+    void probeLoopLag();
+    // 根据连接数、accept速率和subloop延迟决定暂停还是恢复accept
+    void updateAccepting();
 
     EventLoop *loop_; // baseLoop 用户定义的loop
 
     const std::string ipPort_;
     const std::string name_;
+    const TcpConnection::NamePrefixPtr namePrefix_; // "name-ip:port"，所有连接共用
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainLoop，任务就是监听新连接事件
 
@@ -70,6 +126,29 @@ private:
 
     std::atomic_int started_;
 
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有的连接
+    uint64_t nextConnId_; // 只在mainLoop里访问
+    // start()里建好，之后只读，所以mainLoop查找时不需要加锁
+    std::unordered_map<EventLoop*, std::shared_ptr<ConnectionRegistry>> registries_;
+
+    SocketOptions socketOptions_; // 每个新连接上设置的选项，不含从监听socket继承的缓冲区大小
+    size_t readBudget_; // 0表示不限制
+    double loopRateLimit_; // 0表示不限速
+    size_t loopRateBurst_;
+    std::unordered_map<EventLoop*, std::shared_ptr<TokenBucket>> loopLimiters_; // 只在mainLoop里访问
+
+    size_t maxConnections_;
+    size_t maxConnectionsPerIp_;
+    std::unique_ptr<TokenBucket> acceptLimiter_; // 只在mainLoop里访问
+    int64_t acceptResumeAt_; // accept限速暂停到这个时间，单调时钟微秒
+    int64_t maxLoopLag_; // 微秒
+    double lagProbeInterval_;
+    TimerId lagProbeTimer_;
+    TimerId acceptResumeTimer_;
+    std::atomic<int64_t> maxLoopLagMeasured_;
+
+    std::atomic<size_t> connectionCount_;
+    std::atomic<uint64_t> rejectedCount_;
+    std::atomic_bool acceptPaused_;
+    std::mutex ipMutex_;
+    std::unordered_map<uint32_t, size_t> ipCounts_; // 对端IP => 连接数，由ipMutex_保护
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// 定时器，到期时间用单调时钟的微秒数表示，interval大于0表示重复定时器
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, int64_t expiration, int64_t interval)
+        : callback_(std::move(cb))
+        , expiration_(expiration)
+        , interval_(interval)
+        , repeat_(interval > 0)
+        , sequence_(++s_numCreated_)
+    {}
+
+    void run() const { callback_(); }
+
+    int64_t expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器重新计算下一次到期时间
+    void restart(int64_t now) { expiration_ = now + interval_; }
+private:
+    const TimerCallback callback_;
+    int64_t expiration_;
+    const int64_t interval_;
+    const bool repeat_;
+    const int64_t sequence_; // 区分地址相同的新旧定时器
+
+    static std::atomic<int64_t> s_numCreated_;
+};
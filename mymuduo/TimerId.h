@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+// EventLoop::runAfter/runEvery的返回值，用来cancel定时器
+// 只保存地址和序号，定时器已经删除时cancel也是安全的
+class TimerId
+{
+public:
+    TimerId() : timer_(nullptr), sequence_(0) {}
+    TimerId(Timer *timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+    friend class TimerQueue;
+private:
+    Timer *timer_;
+    int64_t sequence_;
+};
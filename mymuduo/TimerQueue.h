@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <set>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+class EventLoop;
+class Timer;
+
+/**
+ * 定时器队列，所有定时器共用一个timerfd，按到期时间排序
+ * timerfd注册到EventLoop的poller上，和IO事件在同一个线程里处理
+ */ 
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全，可以在别的线程里调用，when是单调时钟的微秒数，interval为0表示只执行一次
+    TimerId addTimer(TimerCallback cb, int64_t when, int64_t interval);
+    void cancel(TimerId timerId);
+private:
+    using Entry = std::pair<int64_t, Timer*>; // 到期时间相同时按地址区分
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，执行所有到期的定时器
+    void handleRead();
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(int64_t now);
+    // 重复定时器重新插入，一次性的删除
+    void reset(const std::vector<Entry> &expired, int64_t now);
+    // 插入一个定时器，返回最早到期的时间是否改变了
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_; // 按到期时间排序
+
+    ActiveTimerSet activeTimers_; // 和timers_保存同样的定时器，按地址排序，cancel时查找
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_; // 执行到期回调期间被cancel的重复定时器，不再重新插入
+};
@@ -1,6 +1,18 @@
 #include "Timestamp.h"
 
 #include <time.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+// 每个线程缓存上一次格式化的秒和它的"年/月/日 时:分:秒"，localtime_r只在跨秒时调用
+__thread time_t t_lastSecond = -1;
+__thread char t_secondPrefix[32];
+__thread size_t t_secondPrefixLen = 0;
+
+} // namespace
 
 //默认构造的初始化
 Timestamp::Timestamp():microSecondsSinceEpoch_(0) {}
@@ -12,21 +24,82 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 Timestamp Timestamp::now()
 {
     //获取当前的时间
-    return Timestamp(time(NULL));
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+int64_t Timestamp::monotonicMicroSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
+int64_t Timestamp::monotonicNanoSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+size_t Timestamp::formatTo(char *buf, size_t size, bool showMicroseconds) const
+{
+    time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+        t_lastSecond = seconds;
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time); // 线程安全的版本
+        int len = snprintf(t_secondPrefix, sizeof t_secondPrefix, "%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year + 1900,
+            tm_time.tm_mon + 1,
+            tm_time.tm_mday,
+            tm_time.tm_hour,
+            tm_time.tm_min,
+            tm_time.tm_sec);
+        t_secondPrefixLen = static_cast<size_t>(len);
+    }
+
+    size_t need = t_secondPrefixLen + (showMicroseconds ? 7 : 0);
+    if (size <= need)
+    {
+        if (size > 0)
+        {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+    ::memcpy(buf, t_secondPrefix, t_secondPrefixLen);
+    char *p = buf + t_secondPrefixLen;
+    if (showMicroseconds)
+    {
+        // 微秒部分固定6位，手工转换比snprintf快
+        int micros = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        *p++ = '.';
+        for (int i = 5; i >= 0; --i)
+        {
+            p[i] = static_cast<char>('0' + micros % 10);
+            micros /= 10;
+        }
+        p += 6;
+    }
+    *p = '\0';
+    return need;
 }
 
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d", 
-        tm_time->tm_year + 1900,
-        tm_time->tm_mon + 1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
-    return buf;
+    char buf[64];
+    size_t len = formatTo(buf, sizeof buf, false);
+    return std::string(buf, len);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64];
+    size_t len = formatTo(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, len);
 }
 
 // #include <iostream>
@@ -34,4 +107,4 @@ std::string Timestamp::toString() const
 // {
 //     std::cout << Timestamp::now().toString() << std::endl; 
 //     return 0;
-// }
\ No newline at end of file
+// }
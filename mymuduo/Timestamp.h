@@ -2,8 +2,10 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
 
-// 时间类
+// 时间类，微秒精度
 class Timestamp
 {
 public:
@@ -13,10 +15,51 @@ public:
     /*
     *   静态成员函数，用于获取当前时间的时间戳。
     *   返回一个 Timestamp 对象，表示当前时刻。
+    *   clock_gettime走vDSO，不陷入内核
     */ 
     static Timestamp now();
-    // 将长整型的代码改成字符串
+    // 单调时钟的微秒数，不受系统时间调整影响，用来计算定时器、限速这类时间间隔
+    static int64_t monotonicMicroSeconds();
+    // 单调时钟的纳秒数，测量很短的耗时用
+    static int64_t monotonicNanoSeconds();
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const
+    { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+
+    // 将长整型的代码改成字符串 2026/10/18 17:08:09
     std::string toString() const;
+    // 2026/10/18 17:08:09.123456
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    // 格式化到调用方的缓冲区，返回写入的长度，不分配内存
+    // 每个线程缓存上一次格式化的秒，同一秒内只需要渲染微秒部分
+    size_t formatTo(char *buf, size_t size, bool showMicroseconds = true) const;
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差多少秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
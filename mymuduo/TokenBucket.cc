@@ -0,0 +1,38 @@
+#include "TokenBucket.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+
+TokenBucket::TokenBucket(double bytesPerSecond, size_t burst)
+    : rate_(bytesPerSecond)
+    , burst_(static_cast<double>(std::max<size_t>(burst, 1))) // 容量为0的桶永远攒不到令牌
+    , tokens_(burst_) // 一开始桶是满的
+    , lastRefill_(Timestamp::monotonicMicroSeconds())
+{
+}
+
+void TokenBucket::refill()
+{
+    int64_t now = Timestamp::monotonicMicroSeconds();
+    tokens_ = std::min(burst_, tokens_ + rate_ * (now - lastRefill_) / Timestamp::kMicroSecondsPerSecond);
+    lastRefill_ = now;
+}
+
+size_t TokenBucket::available()
+{
+    refill();
+    return tokens_ > 0 ? static_cast<size_t>(tokens_) : 0;
+}
+
+void TokenBucket::consume(size_t n)
+{
+    // 允许透支，透支的部分让后面多等一会儿
+    tokens_ -= static_cast<double>(n);
+}
+
+double TokenBucket::delayFor(size_t n)
+{
+    refill();
+    double need = std::min(static_cast<double>(n), burst_) - tokens_;
+    return need > 0 ? need / rate_ : 0.0;
+}
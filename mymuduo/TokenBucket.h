@@ -0,0 +1,35 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 令牌桶限速，令牌单位是字节，按rate字节/秒补充，最多攒burst个（TcpServer的accept限速里令牌单位是连接）
+ * 不加锁，只能在一个线程里使用：单个连接的桶属于连接所在的loop，
+ * 整个loop共享的桶也只被这个loop上的连接使用
+ */ 
+class TokenBucket : noncopyable
+{
+public:
+    // burst为0时按1算
+    TokenBucket(double bytesPerSecond, size_t burst);
+
+    // 当前可以发送的字节数
+    size_t available();
+    // 实际发送了n字节以后扣掉令牌
+    void consume(size_t n);
+    // 攒够n个令牌还需要多少秒，n超过burst时按burst算
+    double delayFor(size_t n);
+
+    double rate() const { return rate_; }
+    size_t burst() const { return static_cast<size_t>(burst_); }
+private:
+    void refill();
+
+    const double rate_;
+    const double burst_;
+    double tokens_;
+    int64_t lastRefill_; // 单调时钟微秒数
+};
@@ -0,0 +1,188 @@
+#include "UpstreamPool.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+UpstreamPool::UpstreamPool(EventLoop *loop,
+                const std::vector<InetAddress> &endpoints,
+                const std::string &nameArg,
+                int connectionsPerEndpoint)
+                : loop_(loop)
+                , name_(nameArg)
+                , healthCheckInterval_(0)
+                , nextEndpoint_(0)
+                , connectedCount_(0)
+                , started_(false)
+{
+    for (size_t i = 0; i < endpoints.size(); ++i)
+    {
+        std::unique_ptr<Endpoint> ep(new Endpoint);
+        ep->addr = endpoints[i];
+        ep->inflight = 0;
+        ep->connected = 0;
+        ep->healthy = true;
+        for (int j = 0; j < connectionsPerEndpoint; ++j)
+        {
+            char buf[64] = {0}; // 两个下标最长20位+11位，留足余量
+            snprintf(buf, sizeof buf, "-%zu-%d", i, j);
+            std::unique_ptr<Slot> slot(new Slot);
+            slot->endpoint = ep.get();
+            slot->client.reset(new TcpClient(loop_, endpoints[i], name_ + buf));
+            slot->inflight = 0;
+            slot->client->setConnectionCallback(
+                std::bind(&UpstreamPool::onConnection, this, slot.get(), std::placeholders::_1));
+            slot->client->enableRetry();
+            ep->slots.push_back(slot.get());
+            slots_.push_back(std::move(slot));
+        }
+        endpoints_.push_back(std::move(ep));
+    }
+}
+
+UpstreamPool::~UpstreamPool()
+{
+    loop_->cancel(healthCheckTimer_);
+    // TcpClient析构时会forceClose连接，关闭回调不能再回到已经析构的连接池
+    for (auto &slot : slots_)
+    {
+        if (slot->conn)
+        {
+            slot->conn->setConnectionCallback([](const TcpConnectionPtr&) {});
+            // 先放掉连接池持有的引用，TcpClient析构时才能按unique()判断出自己是最后一个持有者
+            slot->conn.reset();
+        }
+        slot->client.reset();
+    }
+}
+
+void UpstreamPool::start()
+{
+    if (started_)
+    {
+        return;
+    }
+    started_ = true;
+    for (auto &slot : slots_)
+    {
+        // 消息回调直接交给用户，不经过连接池
+        slot->client->setMessageCallback(messageCallback_);
+        slot->client->connect();
+    }
+    if (healthCheckInterval_ > 0 && healthCheckCallback_)
+    {
+        healthCheckTimer_ = loop_->runEvery(healthCheckInterval_,
+                                            std::bind(&UpstreamPool::onHealthCheck, this));
+    }
+}
+
+void UpstreamPool::onConnection(Slot *slot, const TcpConnectionPtr &conn)
+{
+    Endpoint *ep = slot->endpoint;
+    if (conn->connected())
+    {
+        slot->conn = conn;
+        slot->inflight = 0;
+        connSlots_[conn.get()] = slot;
+        ++ep->connected;
+        ++connectedCount_;
+    }
+    else if (slot->conn == conn)
+    {
+        // 连接上没收到响应的请求算作失败，由用户在connectionCallback里处理
+        ep->inflight -= slot->inflight;
+        slot->inflight = 0;
+        slot->conn.reset();
+        connSlots_.erase(conn.get());
+        --ep->connected;
+        --connectedCount_;
+        LOG_INFO("UpstreamPool [%s] - lost connection to %s, %zu left \n",
+            name_.c_str(), ep->addr.toIpPort().c_str(), ep->connected);
+    }
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+TcpConnectionPtr UpstreamPool::acquire()
+{
+    size_t n = endpoints_.size();
+    Endpoint *best = nullptr;
+    for (size_t i = 0; i < n; ++i)
+    {
+        Endpoint *ep = endpoints_[(nextEndpoint_ + i) % n].get();
+        if (ep->healthy && ep->connected > 0
+            && (best == nullptr || ep->inflight < best->inflight))
+        {
+            best = ep;
+        }
+    }
+    if (best == nullptr)
+    {
+        return TcpConnectionPtr();
+    }
+    nextEndpoint_ = n > 0 ? (nextEndpoint_ + 1) % n : 0;
+
+    Slot *chosen = nullptr;
+    for (Slot *slot : best->slots)
+    {
+        if (slot->conn && slot->conn->connected()
+            && (chosen == nullptr || slot->inflight < chosen->inflight))
+        {
+            chosen = slot;
+        }
+    }
+    if (chosen == nullptr)
+    {
+        return TcpConnectionPtr();
+    }
+    ++chosen->inflight;
+    ++best->inflight;
+    return chosen->conn;
+}
+
+void UpstreamPool::release(const TcpConnectionPtr &conn)
+{
+    Slot *slot = findSlot(conn);
+    if (slot && slot->inflight > 0)
+    {
+        --slot->inflight;
+        --slot->endpoint->inflight;
+    }
+}
+
+void UpstreamPool::markHealthy(const TcpConnectionPtr &conn, bool healthy)
+{
+    Slot *slot = findSlot(conn);
+    if (slot && slot->endpoint->healthy != healthy)
+    {
+        slot->endpoint->healthy = healthy;
+        LOG_INFO("UpstreamPool [%s] - endpoint %s marked %s \n", name_.c_str(),
+            slot->endpoint->addr.toIpPort().c_str(), healthy ? "healthy" : "unhealthy");
+    }
+}
+
+size_t UpstreamPool::outstanding(const TcpConnectionPtr &conn) const
+{
+    Slot *slot = findSlot(conn);
+    return slot ? slot->inflight : 0;
+}
+
+void UpstreamPool::onHealthCheck()
+{
+    // 不健康的后端也要继续探测，否则永远恢复不了
+    for (auto &slot : slots_)
+    {
+        if (slot->conn && slot->conn->connected())
+        {
+            healthCheckCallback_(slot->conn);
+        }
+    }
+}
+
+UpstreamPool::Slot* UpstreamPool::findSlot(const TcpConnectionPtr &conn) const
+{
+    auto it = connSlots_.find(conn.get());
+    return it == connSlots_.end() ? nullptr : it->second;
+}
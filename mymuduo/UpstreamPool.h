@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * 每个EventLoop一个的上游连接池，和后端保持长连接
+ * 只能在所属loop的线程里使用，所以不需要加锁；多个subloop各自创建自己的UpstreamPool
+ */ 
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+
+class EventLoop;
+class TcpClient;
+
+class UpstreamPool : noncopyable
+{
+public:
+    // 定期对每条已建立的连接调用，用户在里面发探测请求，收到结果以后调用markHealthy
+    using HealthCheckCallback = std::function<void (const TcpConnectionPtr&)>;
+
+    UpstreamPool(EventLoop *loop,
+                const std::vector<InetAddress> &endpoints,
+                const std::string &nameArg,
+                int connectionsPerEndpoint = 2);
+    ~UpstreamPool(); // 必须在loop线程里析构
+
+    // 需要在start之前设置；后端的响应都交给messageCallback
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setHealthCheck(double intervalSeconds, const HealthCheckCallback &cb)
+    { healthCheckInterval_ = intervalSeconds; healthCheckCallback_ = cb; }
+
+    // 预热：一次性向所有后端建立全部连接，断开以后自动重连
+    void start();
+
+    // 选出进行中请求最少的后端，再选出它下面进行中请求最少的连接，请求计数加一
+    // 没有可用连接时返回空指针
+    TcpConnectionPtr acquire();
+    // 一个请求的响应收完了，请求计数减一
+    void release(const TcpConnectionPtr &conn);
+    // 健康检查的结果，不健康的后端不再被acquire选中，直到再次标记为健康
+    void markHealthy(const TcpConnectionPtr &conn, bool healthy);
+
+    size_t outstanding(const TcpConnectionPtr &conn) const;
+    // 已经建立的连接数，可以用来判断预热是否完成
+    size_t connectedCount() const { return connectedCount_; }
+    EventLoop* getLoop() const { return loop_; }
+private:
+    struct Endpoint;
+    struct Slot
+    {
+        Endpoint *endpoint;
+        std::unique_ptr<TcpClient> client;
+        TcpConnectionPtr conn;
+        size_t inflight;
+    };
+    struct Endpoint
+    {
+        InetAddress addr;
+        std::vector<Slot*> slots;
+        size_t inflight;  // 所有连接上进行中的请求数之和
+        size_t connected;
+        bool healthy;
+    };
+
+    void onConnection(Slot *slot, const TcpConnectionPtr &conn);
+    void onHealthCheck();
+    Slot* findSlot(const TcpConnectionPtr &conn) const;
+
+    EventLoop *loop_;
+    const std::string name_;
+    std::vector<std::unique_ptr<Endpoint>> endpoints_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::unordered_map<TcpConnection*, Slot*> connSlots_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    HealthCheckCallback healthCheckCallback_;
+    double healthCheckInterval_;
+    TimerId healthCheckTimer_;
+
+    size_t nextEndpoint_; // 进行中请求数相同时轮流选，避免总压在第一个后端上
+    size_t connectedCount_;
+    bool started_;
+};
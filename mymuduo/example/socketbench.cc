@@ -0,0 +1,356 @@
+/**
+ * 回环地址上对比SocketOptions各个选项对延迟和吞吐的影响
+ * 每个用例起一个TcpServer，客户端用阻塞socket测三项：
+ *   connect：新建连接到收到第一个响应的时间，fastopen用例的客户端用MSG_FASTOPEN把第一个请求放进SYN里
+ *   rtt：64字节请求/响应的往返时间，服务端分两次send回复（8字节头+56字节体），能看出Nagle和延迟确认的影响
+ *   download：服务端连续发送64MB的吞吐
+ * 用法：./socketbench [rounds]，默认500轮，default用例受Nagle+延迟确认影响每轮约40ms
+ * fastopen需要net.ipv4.tcp_fastopen=3（客户端和服务端都打开）才会真正省掉一个往返，否则退化成普通握手
+ */ 
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/SocketOptions.h>
+#include <mymuduo/Timestamp.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <future>
+#include <unordered_map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace
+{
+
+const size_t kFrameSize = 64;
+const size_t kDownloadBytes = 64 * 1024 * 1024;
+const size_t kChunkSize = 64 * 1024;
+const uint16_t kBasePort = 9600;
+
+struct BenchCase
+{
+    const char *name;
+    SocketOptions options;
+    bool cork; // 服务端用TCP_CORK把两次send合成一个包
+    bool fastOpen; // 客户端用MSG_FASTOPEN建连
+};
+
+// 服务端协议：每个64字节的帧，首字节'P'表示ping，'G'表示开始下载
+class BenchServer
+{
+public:
+    BenchServer(EventLoop *loop, uint16_t port, const BenchCase &bc)
+        : server_(loop, InetAddress(port), bc.name)
+        , cork_(bc.cork)
+        , chunk_(std::make_shared<const std::string>(kChunkSize, 'x'))
+    {
+        server_.setSocketOptions(bc.options);
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                remaining_.erase(conn.get());
+            }
+        });
+        server_.setMessageCallback(std::bind(&BenchServer::onMessage, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        server_.setWriteCompleteCallback(std::bind(&BenchServer::onWriteComplete, this, std::placeholders::_1));
+        server_.start();
+    }
+private:
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        while (buf->readableBytes() >= kFrameSize)
+        {
+            char type = *buf->peek();
+            if (type == 'G')
+            {
+                buf->retrieve(kFrameSize);
+                remaining_[conn.get()] = kDownloadBytes;
+                onWriteComplete(conn);
+                continue;
+            }
+            std::string frame = buf->retrieveAsString(kFrameSize);
+            if (cork_)
+            {
+                conn->setTcpCork(true);
+            }
+            conn->send(frame.substr(0, 8));
+            conn->send(frame.substr(8));
+            if (cork_)
+            {
+                conn->setTcpCork(false);
+            }
+        }
+    }
+
+    // 发送缓冲区空了再发下一块，不让outputBuffer_无限增长
+    void onWriteComplete(const TcpConnectionPtr &conn)
+    {
+        auto it = remaining_.find(conn.get());
+        if (it == remaining_.end() || it->second == 0)
+        {
+            return;
+        }
+        // kDownloadBytes是kChunkSize的整数倍
+        it->second -= kChunkSize;
+        conn->send(chunk_);
+    }
+
+    TcpServer server_;
+    bool cork_;
+    PayloadPtr chunk_;
+    std::unordered_map<TcpConnection*, size_t> remaining_;
+};
+
+sockaddr_in loopbackAddr(uint16_t port)
+{
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = loopbackAddr(port);
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    return fd;
+}
+
+void readFull(int fd, char *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::read(fd, buf + got, len - got);
+        if (n <= 0)
+        {
+            perror("read");
+            exit(1);
+        }
+        got += n;
+    }
+}
+
+void ping(int fd)
+{
+    char frame[kFrameSize];
+    ::memset(frame, 'P', sizeof frame);
+    if (::write(fd, frame, sizeof frame) != (ssize_t)sizeof frame)
+    {
+        perror("write");
+        exit(1);
+    }
+    readFull(fd, frame, sizeof frame);
+}
+
+// 第一个请求随SYN发出，服务端有cookie以后不用等握手完成就能处理请求
+int connectFastOpen(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    sockaddr_in addr = loopbackAddr(port);
+    char frame[kFrameSize];
+    ::memset(frame, 'P', sizeof frame);
+    if (::sendto(fd, frame, sizeof frame, MSG_FASTOPEN, (sockaddr*)&addr, sizeof addr) != (ssize_t)sizeof frame)
+    {
+        perror("sendto");
+        exit(1);
+    }
+    readFull(fd, frame, sizeof frame);
+    return fd;
+}
+
+double percentile(std::vector<double> &v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, static_cast<size_t>(v.size() * p))];
+}
+
+void runCase(uint16_t port, const BenchCase &bc, int rounds)
+{
+    // 建连：connect + 第一个请求的响应
+    std::vector<double> connectUs;
+    for (int i = 0; i < rounds / 10; ++i)
+    {
+        int64_t start = Timestamp::monotonicMicroSeconds();
+        int fd;
+        if (bc.fastOpen)
+        {
+            fd = connectFastOpen(port);
+        }
+        else
+        {
+            fd = connectTo(port);
+            ping(fd);
+        }
+        connectUs.push_back(Timestamp::monotonicMicroSeconds() - start);
+        ::close(fd);
+    }
+
+    int fd = connectTo(port);
+    std::vector<double> rttUs;
+    for (int i = 0; i < rounds; ++i)
+    {
+        int64_t start = Timestamp::monotonicMicroSeconds();
+        ping(fd);
+        rttUs.push_back(Timestamp::monotonicMicroSeconds() - start);
+    }
+
+    char frame[kFrameSize];
+    ::memset(frame, 'G', sizeof frame);
+    std::vector<char> buf(kChunkSize * 4);
+    int64_t start = Timestamp::monotonicMicroSeconds();
+    if (::write(fd, frame, sizeof frame) != (ssize_t)sizeof frame)
+    {
+        perror("write");
+        exit(1);
+    }
+    size_t got = 0;
+    while (got < kDownloadBytes)
+    {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0)
+        {
+            perror("read");
+            exit(1);
+        }
+        got += n;
+    }
+    double seconds = (Timestamp::monotonicMicroSeconds() - start) / 1e6;
+    ::close(fd);
+
+    printf("%-22s %10.1f %10.1f %10.1f %10.1f %12.1f\n", bc.name,
+        percentile(connectUs, 0.5), percentile(rttUs, 0.5), percentile(rttUs, 0.99),
+        percentile(rttUs, 0.999), kDownloadBytes / seconds / (1024 * 1024));
+}
+
+std::vector<BenchCase> makeCases()
+{
+    std::vector<BenchCase> cases;
+    BenchCase bc;
+    bc.cork = false;
+    bc.fastOpen = false;
+
+    bc.name = "default";
+    cases.push_back(bc);
+
+    bc.name = "nodelay";
+    bc.options.tcpNoDelay = true;
+    cases.push_back(bc);
+
+    bc.name = "cork";
+    bc.options.tcpNoDelay = false;
+    bc.cork = true;
+    cases.push_back(bc);
+    bc.cork = false;
+
+    bc.name = "nodelay+quickack";
+    bc.options.tcpNoDelay = true;
+    bc.options.tcpQuickAck = true;
+    cases.push_back(bc);
+    bc.options.tcpQuickAck = false;
+
+    bc.name = "nodelay+buf64K";
+    bc.options.sendBufferSize = 64 * 1024;
+    bc.options.recvBufferSize = 64 * 1024;
+    cases.push_back(bc);
+
+    bc.name = "nodelay+buf4M";
+    bc.options.sendBufferSize = 4 * 1024 * 1024;
+    bc.options.recvBufferSize = 4 * 1024 * 1024;
+    cases.push_back(bc);
+    bc.options.sendBufferSize = 0;
+    bc.options.recvBufferSize = 0;
+
+    bc.name = "nodelay+notsent16K";
+    bc.options.notSentLowat = 16 * 1024;
+    cases.push_back(bc);
+    bc.options.notSentLowat = 0;
+
+    bc.name = "nodelay+deferaccept";
+    bc.options.deferAcceptSeconds = 1;
+    cases.push_back(bc);
+    bc.options.deferAcceptSeconds = 0;
+
+    bc.name = "nodelay+fastopen";
+    bc.options.fastOpenQueue = 64;
+    bc.fastOpen = true;
+    cases.push_back(bc);
+    bc.options.fastOpenQueue = 0;
+    bc.fastOpen = false;
+
+    // 回环上看不到探测包的效果，这里测的是每个新连接多几次setsockopt的开销
+    bc.name = "nodelay+keepalive";
+    bc.options.keepIdleSeconds = 60;
+    bc.options.keepIntervalSeconds = 10;
+    bc.options.keepCount = 3;
+    cases.push_back(bc);
+    bc.options.keepIdleSeconds = 0;
+    bc.options.keepIntervalSeconds = 0;
+    bc.options.keepCount = 0;
+
+    bc.name = "nodelay+nokeepalive";
+    bc.options.keepAlive = false;
+    cases.push_back(bc);
+    bc.options.keepAlive = true;
+
+    bc.name = "nodelay+backlog64";
+    bc.options.listenBacklog = 64;
+    cases.push_back(bc);
+    return cases;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 500;
+    Logger::instance().setLogLevel(ERROR);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    std::vector<BenchCase> cases = makeCases();
+    EventLoop *serverLoop = nullptr;
+    std::promise<void> ready;
+    std::thread serverThread([&]() {
+        EventLoop loop;
+        std::vector<std::unique_ptr<BenchServer>> servers;
+        for (size_t i = 0; i < cases.size(); ++i)
+        {
+            servers.emplace_back(new BenchServer(&loop, kBasePort + i, cases[i]));
+        }
+        serverLoop = &loop;
+        ready.set_value();
+        loop.loop();
+    });
+    ready.get_future().wait();
+
+    printf("%-22s %10s %10s %10s %10s %12s\n", "case", "connect", "rtt p50", "rtt p99", "rtt p999", "download");
+    printf("%-22s %10s %10s %10s %10s %12s\n", "", "us", "us", "us", "us", "MB/s");
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        runCase(kBasePort + i, cases[i], rounds);
+    }
+
+    serverLoop->quit();
+    serverThread.join();
+    return 0;
+}